@@ -5,7 +5,22 @@
       "sources": [
         "src/native/ax_recorder.cpp",
         "src/native/ax_element.cpp",
-        "src/native/event_monitor.cpp"
+        "src/native/event_monitor.cpp",
+        "src/native/hover_prefetcher.cpp",
+        "src/native/window_observer.cpp",
+        "src/native/step_codec.cpp",
+        "src/native/step_ring.cpp",
+        "src/native/recorder_helper_client.cpp",
+        "src/native/csv_reader.cpp",
+        "src/native/flow_template.cpp",
+        "src/native/batch_engine.cpp",
+        "src/native/flow_batch.cpp",
+        "src/native/work_stealing_pool.cpp",
+        "src/native/flow_scheduler.cpp",
+        "src/native/flow_runner.cpp",
+        "src/native/step_js.cpp",
+        "src/native/step_store.cpp",
+        "src/native/step_history.cpp"
       ],
       "include_dirs": [
         "<!@(node -p \"require('node-addon-api').include\")"
@@ -33,6 +48,39 @@
           }
         }]
       ]
+    },
+    {
+      "target_name": "ax_recorder_helper",
+      "type": "executable",
+      "sources": [
+        "src/native/recorder_helper.cpp",
+        "src/native/ax_element.cpp",
+        "src/native/event_monitor.cpp",
+        "src/native/hover_prefetcher.cpp",
+        "src/native/window_observer.cpp",
+        "src/native/step_codec.cpp",
+        "src/native/step_ring.cpp"
+      ],
+      "cflags!": ["-fno-exceptions"],
+      "cflags_cc!": ["-fno-exceptions"],
+      "defines": ["AX_RECORDER_HELPER"],
+      "conditions": [
+        ["OS=='mac'", {
+          "xcode_settings": {
+            "GCC_ENABLE_CPP_EXCEPTIONS": "YES",
+            "CLANG_CXX_LIBRARY": "libc++",
+            "MACOSX_DEPLOYMENT_TARGET": "10.15"
+          },
+          "link_settings": {
+            "libraries": [
+              "-framework ApplicationServices",
+              "-framework Carbon",
+              "-framework CoreGraphics",
+              "-framework Foundation"
+            ]
+          }
+        }]
+      ]
     }
   ]
-}
\ No newline at end of file
+}
@@ -5,6 +5,13 @@ import {
   ApplicationInfo,
   TargetDescriptor,
   RecordedStep,
+  RecorderFilter,
+  BatchOptions,
+  BatchCheckpoint,
+  FlowRunTiming,
+  RunnerOptions,
+  HistoryQuery,
+  HistoryCursor,
   FlowStep,
   FlowVariable,
   Flow,
@@ -98,6 +105,34 @@ describe('Type definitions', () => {
     expect(['click', 'type', 'drag']).toContain(step.action);
   });
 
+  test('RecorderFilter fields should all be optional', () => {
+    const empty: RecorderFilter = {};
+    const filter: RecorderFilter = {
+      actions: ['click', 'drag'],
+      appName: 'Mail',
+      processId: 1234,
+      roles: ['AXButton', 'AXTextField'],
+      region: { x: 0, y: 0, width: 800, height: 600 },
+    };
+
+    expect(Object.keys(empty)).toHaveLength(0);
+    expect(filter.actions).toContain('click');
+    expect(Array.isArray(filter.roles)).toBe(true);
+  });
+
+  test('BatchOptions should accept a checkpoint to resume from', () => {
+    const checkpoint: BatchCheckpoint = { row: 1200, byteOffset: 98304 };
+    const options: BatchOptions = {
+      path: '/tmp/contacts.csv',
+      tableVariable: 'sheet',
+      variables: { subject: 'Hello', retries: 2 },
+      resumeFrom: checkpoint,
+    };
+
+    expect(options.resumeFrom?.row).toBe(1200);
+    expect(typeof options.resumeFrom?.byteOffset).toBe('number');
+  });
+
   test('FlowStep should support different step types', () => {
     const clickStep: FlowStep = {
       type: 'click',
@@ -139,6 +174,45 @@ describe('Type definitions', () => {
     expect(typeof textVar.required).toBe('boolean');
   });
 
+  test('FlowRunTiming should split queueing from execution time', () => {
+    const options: RunnerOptions = { workThreads: 4, stepTimeoutMs: 30000 };
+    const timing: FlowRunTiming = {
+      flowId: 3,
+      name: 'Send invoices',
+      ok: true,
+      cancelled: false,
+      timedOut: false,
+      stepsRun: 5,
+      queuedMicros: 1200,
+      runMicros: 480000,
+      inputMicros: 350000,
+      workMicros: 90000,
+    };
+
+    expect(options.workThreads).toBe(4);
+    expect(timing.queuedMicros).toBeLessThan(timing.runMicros);
+    expect(timing.inputMicros + timing.workMicros).toBeLessThanOrEqual(
+      timing.runMicros
+    );
+  });
+
+  test('HistoryQuery should combine filters with a page cursor', () => {
+    const after: HistoryCursor = { timestamp: 1700000000000, segment: 4, row: 812 };
+    const query: HistoryQuery = {
+      from: 1699990000000,
+      apps: ['Mail', 'Safari'],
+      actions: ['click'],
+      roles: ['AXButton'],
+      newestFirst: true,
+      limit: 50,
+      after,
+    };
+
+    expect(query.apps).toHaveLength(2);
+    expect(query.after?.segment).toBe(4);
+    expect(query.from).toBeLessThan(after.timestamp);
+  });
+
   test('Flow should contain complete flow definition', () => {
     const flow: Flow = {
       version: '0.1',
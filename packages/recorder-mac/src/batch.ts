@@ -0,0 +1,140 @@
+import { createRequire } from 'module';
+import {
+  BatchCheckpoint,
+  BatchOptions,
+  BatchProgress,
+  BoundFlowRow,
+  Flow,
+  FlowStep,
+  RowTiming,
+} from './types.js';
+
+type BoundFields = Pick<FlowStep, 'selector' | 'text' | 'url'>;
+
+// Native addon interface
+interface NativeFlowBatch {
+  nextRows(maxRows: number): {
+    row: number;
+    byteOffset: number;
+    steps: BoundFields[];
+  }[];
+  completeRow(row: number, ok: boolean): boolean;
+  cancel(): boolean;
+  isDone(): boolean;
+  getColumns(): string[];
+  getProgress(): BatchProgress;
+  getCheckpoint(): BatchCheckpoint;
+  takeRowTimings(): RowTiming[];
+}
+
+/**
+ * Runs one flow over every row of a CSV/TSV table variable. The native side
+ * streams the file, binds each row into templates compiled once for the flow
+ * and keeps a bounded queue of ready rows ahead of the replay.
+ */
+export class FlowBatch {
+  private nativeBatch: NativeFlowBatch;
+
+  constructor(
+    private readonly flow: Flow,
+    options: BatchOptions
+  ) {
+    const tableVariable =
+      options.tableVariable ??
+      flow.variables.find((variable) => variable.type === 'table')?.name;
+
+    try {
+      // Load the native addon using createRequire for ES modules
+      const require = createRequire(import.meta.url);
+      const addon = require('../build/Release/ax_recorder.node');
+      this.nativeBatch = new addon.FlowBatch({
+        ...options,
+        tableVariable,
+        steps: flow.steps,
+      });
+    } catch (error) {
+      throw new Error(`Failed to start flow batch: ${error}`);
+    }
+  }
+
+  /**
+   * Yield bound rows in order. Call completeRow() once each row has been
+   * replayed so progress and the checkpoint advance.
+   * @param pollMs Wait between polls when the parser has not caught up
+   */
+  public async *rows(pollMs: number = 10): AsyncGenerator<BoundFlowRow> {
+    while (true) {
+      // Read before polling: once parsing is done an empty poll is final
+      const parseDone = this.nativeBatch.getProgress().parseDone;
+      const ready = this.nativeBatch.nextRows(64);
+
+      if (ready.length === 0) {
+        if (parseDone) {
+          return;
+        }
+        await new Promise((resolve) => setTimeout(resolve, pollMs));
+        continue;
+      }
+
+      for (const bound of ready) {
+        yield {
+          row: bound.row,
+          byteOffset: bound.byteOffset,
+          steps: this.flow.steps.map((step, index) => ({
+            ...step,
+            ...bound.steps[index],
+          })),
+        };
+      }
+    }
+  }
+
+  /**
+   * Record the outcome of a replayed row
+   */
+  public completeRow(row: number, ok: boolean = true): boolean {
+    return this.nativeBatch.completeRow(row, ok);
+  }
+
+  /**
+   * Stop parsing; rows already handed out can still be completed
+   */
+  public cancel(): void {
+    this.nativeBatch.cancel();
+  }
+
+  /**
+   * True once every row has been parsed and completed
+   */
+  public isDone(): boolean {
+    return this.nativeBatch.isDone();
+  }
+
+  /**
+   * Get the table header
+   */
+  public getColumns(): string[] {
+    return this.nativeBatch.getColumns();
+  }
+
+  /**
+   * Get row and byte counters for progress reporting
+   */
+  public getProgress(): BatchProgress {
+    return this.nativeBatch.getProgress();
+  }
+
+  /**
+   * Get the point a later run can resume from
+   */
+  public getCheckpoint(): BatchCheckpoint {
+    return this.nativeBatch.getCheckpoint();
+  }
+
+  /**
+   * Take per-row timings recorded since the last call
+   */
+  public takeRowTimings(): RowTiming[] {
+    return this.nativeBatch.takeRowTimings();
+  }
+}
@@ -0,0 +1,88 @@
+import { createRequire } from 'module';
+import {
+  HistoryOptions,
+  HistoryPage,
+  HistoryQuery,
+  HistoryStats,
+  RecordedStep,
+} from './types.js';
+
+// Native addon interface
+interface NativeStepHistory {
+  append(steps: RecordedStep[]): number;
+  flush(): boolean;
+  refresh(): boolean;
+  query(query: HistoryQuery): HistoryPage;
+  getStats(): HistoryStats;
+}
+
+/**
+ * Persistent, indexed history of recorded steps. Steps are stored in
+ * time-sorted segment files under `directory`, and queries run natively
+ * over memory-mapped segments. Only the requested page reaches JS.
+ */
+export class StepHistory {
+  private nativeHistory: NativeStepHistory;
+
+  constructor(directory: string, options: HistoryOptions = {}) {
+    try {
+      // Load the native addon using createRequire for ES modules
+      const require = createRequire(import.meta.url);
+      const addon = require('../build/Release/ax_recorder.node');
+      this.nativeHistory = new addon.StepHistory(directory, options);
+    } catch (error) {
+      throw new Error(`Failed to open step history: ${error}`);
+    }
+  }
+
+  /**
+   * Add steps. They are written out once a segment fills up, or on flush(),
+   * and are queryable from then on. Steps still buffered are not returned by
+   * query(); `getStats().pendingSteps` counts them.
+   */
+  public append(steps: RecordedStep[]): number {
+    return this.nativeHistory.append(steps);
+  }
+
+  /**
+   * Write pending steps as a segment and make them queryable
+   */
+  public flush(): void {
+    this.nativeHistory.flush();
+  }
+
+  /**
+   * Pick up segments written by other StepHistory instances or processes
+   */
+  public refresh(): void {
+    this.nativeHistory.refresh();
+  }
+
+  /**
+   * Get one page of matching steps, oldest first unless `newestFirst`
+   */
+  public query(query: HistoryQuery = {}): HistoryPage {
+    return this.nativeHistory.query(query);
+  }
+
+  /**
+   * Iterate over every matching step, one page at a time
+   */
+  public *queryAll(query: HistoryQuery = {}): Generator<RecordedStep> {
+    let page = this.query(query);
+    while (true) {
+      yield* page.steps;
+      if (!page.hasMore || !page.next) {
+        return;
+      }
+      page = this.query({ ...query, after: page.next });
+    }
+  }
+
+  /**
+   * Get segment and step counts and the covered time range
+   */
+  public getStats(): HistoryStats {
+    return this.nativeHistory.getStats();
+  }
+}
@@ -1,4 +1,7 @@
 export { MacRecorder } from './recorder.js';
+export { FlowBatch } from './batch.js';
+export { FlowRunner } from './runner.js';
+export { StepHistory } from './history.js';
 export * from './types.js';
 
 // Re-export for convenience
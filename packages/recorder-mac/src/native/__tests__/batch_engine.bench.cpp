@@ -0,0 +1,169 @@
+// Throughput of the batch pipeline over a generated multi-gigabyte table:
+// a byte-at-a-time scan for reference, CsvReader alone, and BatchEngine
+// parsing, binding and queueing every row.
+//
+//   batch_engine_bench [gigabytes=2] [path]
+//
+// The table is written to `path` (default: a temporary file, removed after)
+// unless it already exists there, so repeated runs can reuse it.
+
+#include "batch_engine.h"
+#include "temp_file.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <fcntl.h>
+#include <memory>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+static double cpuSeconds() {
+    timespec now;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &now);
+    return static_cast<double>(now.tv_sec) + static_cast<double>(now.tv_nsec) * 1e-9;
+}
+
+static bool generate(const std::string& path, unsigned long long targetBytes) {
+    FILE* file = std::fopen(path.c_str(), "w");
+    if (!file) {
+        return false;
+    }
+    std::vector<char> buffer(1 << 22);
+    setvbuf(file, buffer.data(), _IOFBF, buffer.size());
+
+    unsigned long long bytes = static_cast<unsigned long long>(
+        std::fprintf(file, "id,name,email,company,city,amount,date,note\n"));
+    unsigned seed = 1;
+    for (unsigned long long row = 0; bytes < targetBytes; row++) {
+        seed = seed * 1103515245u + 12345u;
+        bool quoted = (seed >> 16) % 5 == 0;
+        int written = std::fprintf(file,
+            "%llu,Name %u,user%llu@example.com,Company %u Inc,City%u,%u.%02u,2024-%02u-%02u,%s\n",
+            row, seed % 100000, row, (seed >> 8) % 5000, (seed >> 4) % 300, seed % 100000, seed % 100,
+            seed % 12 + 1, seed % 28 + 1, quoted ? "\"Quoted, with \"\"escapes\"\"\"" : "plain note text");
+        if (written < 0) {
+            std::fclose(file);
+            return false;
+        }
+        bytes += static_cast<unsigned long long>(written);
+    }
+    return std::fclose(file) == 0;
+}
+
+static void naiveScan(const std::string& path) {
+    int fd = open(path.c_str(), O_RDONLY);
+    std::vector<char> buffer(1 << 20);
+    unsigned long long rows = 0;
+    unsigned long long bytes = 0;
+    bool quoted = false;
+    double startedAt = cpuSeconds();
+    ssize_t received;
+    while ((received = read(fd, buffer.data(), buffer.size())) > 0) {
+        bytes += static_cast<unsigned long long>(received);
+        for (ssize_t i = 0; i < received; i++) {
+            char c = buffer[i];
+            if (c == '"') {
+                quoted = !quoted;
+            } else if (!quoted && c == '\n') {
+                rows++;
+            }
+        }
+    }
+    close(fd);
+    double elapsed = cpuSeconds() - startedAt;
+    std::printf("byte scan:    %llu rows, %.2f GB in %.2f s = %.0f MB/s\n",
+                rows, bytes / 1e9, elapsed, bytes / 1e6 / elapsed);
+}
+
+static void readerOnly(const std::string& path) {
+    std::unique_ptr<CsvReader> reader = CsvReader::open(path);
+    std::vector<std::string_view> fields;
+    unsigned long long rows = 0;
+    double startedAt = cpuSeconds();
+    while (reader->readRow(fields)) {
+        rows++;
+    }
+    double elapsed = cpuSeconds() - startedAt;
+    double bytes = static_cast<double>(reader->bytesConsumed());
+    std::printf("CsvReader:    %llu rows, %.2f GB in %.2f s = %.0f MB/s, %.1f M rows/s\n",
+                rows, bytes / 1e9, elapsed, bytes / 1e6 / elapsed, rows / 1e6 / elapsed);
+}
+
+static void engine(const std::string& path) {
+    BatchConfig config;
+    config.path = path;
+    config.tableVariable = "sheet";
+    config.variables = {{"subject", "Quarterly update"}};
+    BatchStepTemplate to;
+    to.hasSelector = true;
+    to.selector = "textarea[name=to]";
+    to.hasText = true;
+    to.text = "{{row.email}}";
+    BatchStepTemplate body;
+    body.hasText = true;
+    body.text = "Hello {{row.name}} from {{row.company}},\n{{subject}}: {{row.amount}} due {{row.date}}. {{row.note}}";
+    BatchStepTemplate url;
+    url.hasUrl = true;
+    url.url = "https://crm.example.com/{{row.city}}/{{row.id}}";
+    config.steps = {to, body, url};
+    config.queueCapacity = 1024;
+
+    BatchEngine batch;
+    std::string error;
+    if (!batch.start(config, error)) {
+        std::printf("BatchEngine: %s\n", error.c_str());
+        return;
+    }
+
+    auto startedAt = std::chrono::steady_clock::now();
+    std::vector<BoundRow> rows;
+    unsigned long long completed = 0;
+    unsigned long long rendered = 0;
+    while (!batch.finished()) {
+        if (batch.next(rows, 256) == 0) {
+            std::this_thread::sleep_for(std::chrono::microseconds(200));
+            continue;
+        }
+        for (const BoundRow& row : rows) {
+            rendered += row.values.size();
+            batch.complete(row.row, true);
+            completed++;
+        }
+    }
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - startedAt).count();
+    BatchProgress progress = batch.progress();
+    std::printf("BatchEngine:  %llu rows, %.2f GB in %.2f s = %.0f MB/s, %.2f M rows/s, "
+                "%.0f MB rendered, %.0f ns bind per row\n",
+                completed, progress.bytesRead / 1e9, elapsed, progress.bytesRead / 1e6 / elapsed,
+                completed / 1e6 / elapsed, rendered / 1e6,
+                static_cast<double>(progress.bindNanos) / static_cast<double>(completed));
+}
+
+int main(int argc, char** argv) {
+    double gigabytes = argc > 1 ? std::atof(argv[1]) : 2.0;
+    std::unique_ptr<TempFile> scratch;
+    std::string path;
+    if (argc > 2) {
+        path = argv[2];
+    } else {
+        scratch.reset(new TempFile(".csv"));
+        path = scratch->path();
+    }
+
+    struct stat info;
+    if (stat(path.c_str(), &info) != 0 || info.st_size == 0) {
+        std::printf("generating %.1f GB table at %s\n", gigabytes, path.c_str());
+        if (!generate(path, static_cast<unsigned long long>(gigabytes * 1e9))) {
+            std::printf("cannot write %s\n", path.c_str());
+            return 1;
+        }
+    }
+
+    naiveScan(path);
+    readerOnly(path);
+    engine(path);
+    return 0;
+}
@@ -0,0 +1,272 @@
+#include "batch_engine.h"
+#include "temp_file.h"
+#include "test_support.h"
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+static std::string contactsTable(int rows) {
+    std::string contents = "\xEF\xBB\xBFname,email,note\n";
+    for (int i = 0; i < rows; i++) {
+        contents += "n" + std::to_string(i) + ",e" + std::to_string(i) + "@x.com,\"a,\"\"b\"\"\"\n";
+    }
+    return contents;
+}
+
+static BatchConfig contactsConfig(const std::string& path) {
+    BatchConfig config;
+    config.path = path;
+    config.tableVariable = "sheet";
+    config.variables = {{"subject", "Hi"}};
+
+    BatchStepTemplate to;
+    to.hasSelector = true;
+    to.selector = "input[name=to]";
+    to.hasText = true;
+    to.text = "{{ row.email }}";
+    BatchStepTemplate body;
+    body.hasText = true;
+    body.text = "Hello {{sheet.name}}, {{subject}} {{row.note}}";
+    config.steps = {to, body};
+    config.queueCapacity = 16;
+    return config;
+}
+
+static std::string render(const BatchEngine& engine, const BoundRow& row) {
+    std::string out;
+    for (size_t slot = 0; slot < engine.slots().size(); slot++) {
+        out += row.value(slot);
+        out += ';';
+    }
+    return out;
+}
+
+// Pulls rows five at a time and completes each batch in reverse, so the
+// checkpoint has to wait for stragglers. Rows at index % 7 == 3 fail.
+// Stops after `limit` rows have been pulled and completed.
+static std::vector<std::string> drain(BatchEngine& engine, uint64_t limit = UINT64_MAX) {
+    std::vector<std::string> rendered;
+    std::vector<BoundRow> rows;
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(30);
+    while (!engine.finished() && rendered.size() < limit && std::chrono::steady_clock::now() < deadline) {
+        size_t wanted = static_cast<size_t>(std::min<uint64_t>(5, limit - rendered.size()));
+        if (engine.next(rows, wanted) == 0) {
+            std::this_thread::yield();
+            continue;
+        }
+        for (const BoundRow& row : rows) {
+            rendered.push_back(render(engine, row));
+        }
+        for (size_t i = rows.size(); i-- > 0;) {
+            engine.complete(rows[i].row, rows[i].row % 7 != 3);
+        }
+    }
+    return rendered;
+}
+
+TEST(bindsEveryRow) {
+    TempFile file(".csv");
+    CHECK(file.write(contactsTable(1000)));
+    BatchEngine engine;
+    std::string error;
+    CHECK(engine.start(contactsConfig(file.path()), error));
+
+    std::vector<std::string> rendered = drain(engine);
+    CHECK(rendered.size() == 1000);
+    CHECK(rendered[5] == "input[name=to];e5@x.com;Hello n5, Hi a,\"b\";");
+
+    BatchProgress progress = engine.progress();
+    CHECK(progress.rowsCompleted == 1000 && progress.rowsFailed == 143);
+    CHECK(progress.parseDone && !progress.readFailed && progress.bytesRead == progress.totalBytes);
+
+    std::vector<RowTiming> timings;
+    CHECK(engine.takeTimings(timings) == 1000);
+    CHECK(timings[0].row == 4 && timings[1].row == 3 && !timings[1].ok);
+
+    BatchCheckpoint checkpoint = engine.checkpoint();
+    CHECK(checkpoint.row == 1000 && checkpoint.offset == progress.totalBytes);
+}
+
+TEST(rejectsUnknownPlaceholders) {
+    TempFile file(".csv");
+    CHECK(file.write(contactsTable(3)));
+    std::string error;
+
+    BatchConfig config = contactsConfig(file.path());
+    BatchStepTemplate url;
+    url.hasUrl = true;
+    url.url = "https://x/{{row.missing}}";
+    config.steps.push_back(url);
+    BatchEngine missingColumn;
+    CHECK(!missingColumn.start(config, error) && !error.empty());
+
+    config = contactsConfig(file.path());
+    config.steps[1].text = "{{nope}}";
+    BatchEngine missingVariable;
+    CHECK(!missingVariable.start(config, error) && !error.empty());
+
+    config.path = "/nonexistent/table.csv";
+    BatchEngine missingFile;
+    CHECK(!missingFile.start(config, error));
+}
+
+TEST(resumesFromCheckpoint) {
+    TempFile file(".csv");
+    CHECK(file.write(contactsTable(1000)));
+    BatchConfig config = contactsConfig(file.path());
+    std::string error;
+
+    BatchEngine complete;
+    CHECK(complete.start(config, error));
+    std::vector<std::string> all = drain(complete);
+
+    BatchEngine interrupted;
+    CHECK(interrupted.start(config, error));
+    drain(interrupted, 435);
+    // The parser keeps filling the queue; the checkpoint must not move with it
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    BatchCheckpoint checkpoint = interrupted.checkpoint();
+    CHECK(checkpoint.row == 435);
+    interrupted.cancel();
+
+    // By offset
+    BatchConfig resumed = config;
+    resumed.startRow = checkpoint.row;
+    resumed.startOffset = checkpoint.offset;
+    BatchEngine seeking;
+    CHECK(seeking.start(resumed, error));
+    std::vector<std::string> rest = drain(seeking);
+    CHECK(rest.size() == 565 && rest.front() == all[435] && rest.back() == all[999]);
+
+    // By row count; the offsets it reports match the seek
+    resumed.startOffset = 0;
+    BatchEngine skipping;
+    CHECK(skipping.start(resumed, error));
+    std::vector<BoundRow> rows;
+    while (skipping.next(rows, 1) == 0) {
+        std::this_thread::yield();
+    }
+    CHECK(rows[0].row == 435 && rows[0].offset == checkpoint.offset);
+    CHECK(skipping.checkpoint().row == 435 && skipping.checkpoint().offset == checkpoint.offset);
+}
+
+TEST(checkpointHoldsWhileSkipping) {
+    TempFile file(".csv");
+    CHECK(file.write(contactsTable(20000)));
+    BatchConfig config = contactsConfig(file.path());
+    config.startRow = 15000;
+    std::string error;
+
+    BatchEngine reference;
+    BatchConfig seekless = config;
+    seekless.startRow = 0;
+    CHECK(reference.start(seekless, error));
+    std::vector<std::string> all = drain(reference);
+
+    // Every checkpoint taken along the way, including mid-skip, must resume
+    // at row 15000: either the original count or the row's real offset
+    BatchEngine engine;
+    CHECK(engine.start(config, error));
+    std::vector<BatchCheckpoint> seen;
+    auto record = [&] {
+        BatchCheckpoint checkpoint = engine.checkpoint();
+        if (seen.empty() || seen.back().row != checkpoint.row || seen.back().offset != checkpoint.offset) {
+            seen.push_back(checkpoint);
+        }
+    };
+    while (!engine.finished() && engine.progress().rowsQueued == 0) {
+        record();
+    }
+    record();
+    engine.cancel();
+
+    CHECK(seen.size() <= 2);
+    for (const BatchCheckpoint& checkpoint : seen) {
+        CHECK(checkpoint.row == 15000);
+        BatchConfig resumed = config;
+        resumed.startOffset = checkpoint.offset;
+        BatchEngine resuming;
+        CHECK(resuming.start(resumed, error));
+        std::vector<std::string> rest = drain(resuming, 1);
+        CHECK(!rest.empty() && rest[0] == all[15000]);
+    }
+}
+
+TEST(uncompletedRowBoundsPendingRows) {
+    TempFile file(".csv");
+    CHECK(file.write(contactsTable(5000)));
+    BatchEngine engine;
+    std::string error;
+    CHECK(engine.start(contactsConfig(file.path()), error));
+
+    // Row 0 is held back; everything after it completes at once
+    std::vector<BoundRow> rows;
+    uint64_t held = UINT64_MAX;
+    uint64_t handedOut = 0;
+    auto idleSince = std::chrono::steady_clock::now();
+    while (std::chrono::steady_clock::now() - idleSince < std::chrono::milliseconds(200)) {
+        if (engine.next(rows, 8) == 0) {
+            std::this_thread::yield();
+            continue;
+        }
+        idleSince = std::chrono::steady_clock::now();
+        for (const BoundRow& row : rows) {
+            handedOut++;
+            if (row.row == 0) {
+                held = row.row;
+            } else {
+                engine.complete(row.row, true);
+            }
+        }
+    }
+
+    // Parsing stalls at the window: 4 x queueCapacity (16) rows, plus the queue
+    CHECK(held == 0);
+    CHECK(handedOut <= 64);
+    CHECK(engine.progress().rowsParsed <= 64 + 16);
+    CHECK(!engine.progress().parseDone);
+    CHECK(engine.checkpoint().row == 0);
+
+    // Completing the straggler releases the rest
+    CHECK(engine.complete(held, true));
+    drain(engine);
+    CHECK(engine.finished());
+    CHECK(engine.progress().rowsCompleted == 5000);
+}
+
+TEST(skipPastEndKeepsResumePoint) {
+    TempFile file(".csv");
+    CHECK(file.write(contactsTable(10)));
+    BatchConfig config = contactsConfig(file.path());
+    config.startRow = 50;
+    std::string error;
+
+    BatchEngine engine;
+    CHECK(engine.start(config, error));
+    CHECK(drain(engine).empty());
+    CHECK(engine.finished());
+    // Not the header end: resuming there would replay every row as row 50
+    BatchCheckpoint checkpoint = engine.checkpoint();
+    CHECK(checkpoint.row == 50 && checkpoint.offset == 0);
+}
+
+TEST(tabSeparatedWithCarriageReturns) {
+    TempFile file(".tsv");
+    CHECK(file.write("a\tb\r\n1\t2\r\n3\t4"));
+    BatchConfig config;
+    config.path = file.path();
+    BatchStepTemplate step;
+    step.hasText = true;
+    step.text = "{{row.b}}{{row.a}}";
+    config.steps = {step};
+
+    BatchEngine engine;
+    std::string error;
+    CHECK(engine.start(config, error));
+    std::vector<std::string> rendered = drain(engine);
+    CHECK(rendered.size() == 2 && rendered[0] == "21;" && rendered[1] == "43;");
+}
+
+RUN_TESTS()
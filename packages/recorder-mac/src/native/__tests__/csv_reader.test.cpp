@@ -0,0 +1,149 @@
+#include "csv_reader.h"
+#include "temp_file.h"
+#include "test_support.h"
+#include <random>
+#include <string>
+#include <vector>
+
+using Table = std::vector<std::vector<std::string>>;
+
+// Quotes a field only when it has to, like most spreadsheet exports
+static void writeField(const std::string& field, char delimiter, std::string& out) {
+    if (field.find_first_of(std::string("\"\r\n") + delimiter) == std::string::npos) {
+        out += field;
+        return;
+    }
+    out += '"';
+    for (char c : field) {
+        out += c;
+        if (c == '"') {
+            out += '"';
+        }
+    }
+    out += '"';
+}
+
+static std::string writeTable(const Table& table, char delimiter, const char* newline, bool finalNewline) {
+    std::string out;
+    for (size_t r = 0; r < table.size(); r++) {
+        for (size_t f = 0; f < table[r].size(); f++) {
+            if (f > 0) {
+                out += delimiter;
+            }
+            // A lone empty field would read back as a blank line
+            if (table[r].size() == 1 && table[r][f].empty()) {
+                out += "\"\"";
+            } else {
+                writeField(table[r][f], delimiter, out);
+            }
+        }
+        if (finalNewline || r + 1 < table.size()) {
+            out += newline;
+        }
+    }
+    return out;
+}
+
+static Table readAll(CsvReader& reader) {
+    Table rows;
+    std::vector<std::string_view> fields;
+    while (reader.readRow(fields)) {
+        rows.emplace_back(fields.begin(), fields.end());
+    }
+    return rows;
+}
+
+TEST(quotingAndLineEndings) {
+    TempFile file(".csv");
+    CHECK(file.write("a,\"b,c\",\"say \"\"hi\"\"\"\r\n\r\n\"multi\nline\",,x\n\nlast,row"));
+    std::unique_ptr<CsvReader> reader = CsvReader::open(file.path());
+    CHECK(reader != nullptr);
+
+    Table rows = readAll(*reader);
+    CHECK(rows.size() == 3);
+    CHECK(rows[0] == (std::vector<std::string>{"a", "b,c", "say \"hi\""}));
+    CHECK(rows[1] == (std::vector<std::string>{"multi\nline", "", "x"}));
+    CHECK(rows[2] == (std::vector<std::string>{"last", "row"}));
+    CHECK(!reader->failed());
+    CHECK(reader->bytesConsumed() == reader->fileSize());
+}
+
+TEST(byteOrderMarkIsSkipped) {
+    TempFile file(".csv");
+    CHECK(file.write("\xEF\xBB\xBFname,email\nAda,ada@example.com\n"));
+    std::unique_ptr<CsvReader> reader = CsvReader::open(file.path());
+    Table rows = readAll(*reader);
+    CHECK(rows.size() == 2 && rows[0][0] == "name" && rows[1][1] == "ada@example.com");
+}
+
+TEST(delimiterFollowsExtension) {
+    TempFile file(".tsv");
+    CHECK(file.write("a\tb,c\n1\t2\n"));
+    std::unique_ptr<CsvReader> reader = CsvReader::open(file.path());
+    CHECK(reader->delimiter() == '\t');
+    Table rows = readAll(*reader);
+    CHECK(rows.size() == 2 && rows[0][1] == "b,c");
+}
+
+TEST(missingFileFailsToOpen) {
+    CHECK(CsvReader::open("/nonexistent/table.csv") == nullptr);
+}
+
+TEST(seekResumesAtRowOffset) {
+    TempFile file(".csv");
+    std::string contents = "h1,h2\n";
+    for (int i = 0; i < 500; i++) {
+        contents += std::to_string(i) + ",\"v\n" + std::to_string(i) + "\"\n";
+    }
+    CHECK(file.write(contents));
+
+    std::unique_ptr<CsvReader> reader = CsvReader::open(file.path(), 0, 256);
+    std::vector<std::string_view> fields;
+    uint64_t offset = 0;
+    for (int i = 0; i <= 300; i++) {
+        CHECK(reader->readRow(fields));
+        offset = reader->rowOffset();
+    }
+    CHECK(fields[0] == "299");
+
+    CHECK(reader->seek(offset));
+    CHECK(reader->readRow(fields));
+    CHECK(fields[0] == "299" && fields[1] == "v\n299");
+    CHECK(readAll(*reader).size() == 200);
+}
+
+// Random tables full of delimiters, quotes, CR/LF and multi-byte text, read
+// back at chunk sizes that split rows, fields and quote pairs everywhere
+TEST(randomTablesRoundTrip) {
+    static const char* const kPieces[] = {"a", "b", ",", "\"", "\n", "\r\n", "x y", "\xC3\xA9", "\t", ""};
+    static const size_t kChunkSizes[] = {64, 65, 100, 4096, 1 << 20};
+    std::mt19937 random(1234);
+
+    for (int round = 0; round < 400; round++) {
+        char delimiter = round % 4 == 0 ? '\t' : ',';
+        Table table(1 + random() % 60);
+        for (std::vector<std::string>& row : table) {
+            row.resize(1 + random() % 6);
+            for (std::string& field : row) {
+                for (size_t i = random() % 9; i > 0; i--) {
+                    field += kPieces[random() % 10];
+                }
+            }
+        }
+
+        TempFile file(delimiter == '\t' ? ".tsv" : ".csv");
+        CHECK(file.write(writeTable(table, delimiter, random() % 2 ? "\n" : "\r\n", random() % 2)));
+        for (size_t chunkSize : kChunkSizes) {
+            std::unique_ptr<CsvReader> reader = CsvReader::open(file.path(), 0, chunkSize);
+            Table rows = readAll(*reader);
+            CHECK(rows == table);
+            CHECK(reader->bytesConsumed() == reader->fileSize());
+            if (rows != table) {
+                std::fprintf(stderr, "round %d, chunk %zu\n", round, chunkSize);
+                return;
+            }
+        }
+    }
+}
+
+RUN_TESTS()
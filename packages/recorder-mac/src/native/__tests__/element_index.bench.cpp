@@ -0,0 +1,59 @@
+// Measures hitTest and insert on a full index: 16 windows of 512 elements,
+// random points over the whole desktop. Usage: element_index_bench [queries]
+
+#include "element_index.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+
+int main(int argc, char** argv) {
+    const int queries = argc > 1 ? std::atoi(argv[1]) : 5000000;
+    using Index = ElementIndex<int>;
+
+    Index index(1LL << 60, 512, 16, 64);
+    std::mt19937 rng(1);
+    for (int w = 0; w < 16; w++) {
+        IndexRect window = {w * 50, w * 30, 1200, 800};
+        for (int i = 0; i < 512; i++) {
+            int x = static_cast<int>(rng() % 1150);
+            int y = static_cast<int>(rng() % 780);
+            index.insert(w, 1, window,
+                         {window.x + x, window.y + y, 10 + static_cast<int>(rng() % 200), 10 + static_cast<int>(rng() % 60)},
+                         w * 1000 + i, w * 1000 + i);
+        }
+    }
+
+    int hits = 0;
+    auto startedAt = std::chrono::steady_clock::now();
+    for (int i = 0; i < queries; i++) {
+        Index::Hit hit;
+        hits += index.hitTest(static_cast<int>(rng() % 2000), static_cast<int>(rng() % 1300), 0, 1, hit);
+    }
+    double nanos = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - startedAt).count();
+    std::printf("hitTest: %.1f ns/query, %.0f%% hits, %zu elements\n",
+                nanos / queries, 100.0 * hits / queries, index.getStats().elements);
+
+    // Same lookup with a payload check, as the click path does it
+    hits = 0;
+    startedAt = std::chrono::steady_clock::now();
+    for (int i = 0; i < queries; i++) {
+        Index::Hit hit;
+        int wanted = static_cast<int>(rng() % 16000);
+        hits += index.hitTest(static_cast<int>(rng() % 2000), static_cast<int>(rng() % 1300), 0, 1,
+                              [wanted](int payload) { return payload % 1000 >= wanted % 1000; }, hit);
+    }
+    nanos = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - startedAt).count();
+    std::printf("hitTest with accept: %.1f ns/query, %.0f%% hits\n", nanos / queries, 100.0 * hits / queries);
+
+    startedAt = std::chrono::steady_clock::now();
+    for (int i = 0; i < queries; i++) {
+        int w = i % 16;
+        index.insert(w, 1, {w * 50, w * 30, 1200, 800},
+                     {w * 50 + static_cast<int>(rng() % 1150), w * 30 + static_cast<int>(rng() % 780), 20, 20},
+                     i, 20000 + i);
+    }
+    nanos = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - startedAt).count();
+    std::printf("insert: %.1f ns/op\n", nanos / queries);
+    return 0;
+}
@@ -0,0 +1,184 @@
+#include "element_index.h"
+#include "test_support.h"
+#include <string>
+
+using Index = ElementIndex<std::string>;
+
+static const IndexRect kWindow = {100, 100, 400, 300};
+
+static bool hitPayload(Index& index, int x, int y, long long now, const std::string& expected) {
+    Index::Hit hit;
+    return index.hitTest(x, y, 0, now, hit) && *hit.payload == expected;
+}
+
+TEST(insertAndInnermostHit) {
+    Index index(1000, 8, 4, 64);
+    index.insert(1, 10, kWindow, {120, 120, 200, 100}, "group", 0);
+    index.insert(1, 10, kWindow, {130, 130, 50, 20}, "button", 0);
+
+    CHECK(hitPayload(index, 140, 140, 1, "button"));
+    CHECK(hitPayload(index, 300, 200, 1, "group"));
+
+    Index::Hit hit;
+    CHECK(!index.hitTest(450, 350, 0, 1, hit));
+    CHECK(!index.hitTest(140, 140, 11, 1, hit)); // Other owner
+    CHECK(index.hitTest(140, 140, 10, 1, hit) && *hit.payload == "button");
+    CHECK(hit.frame.x == 130 && hit.frame.y == 130 && hit.frame.width == 50);
+}
+
+TEST(sameFrameRefreshesInPlace) {
+    Index index(1000, 8, 4, 64);
+    index.insert(1, 10, kWindow, {130, 130, 50, 20}, "old", 0);
+    index.insert(1, 10, kWindow, {130, 130, 50, 20}, "new", 900);
+
+    CHECK(index.getStats().elements == 1);
+    CHECK(hitPayload(index, 140, 140, 1500, "new")); // Refreshed timestamp too
+}
+
+TEST(windowMoveShiftsEntries) {
+    Index index(1000, 8, 4, 64);
+    index.insert(1, 10, kWindow, {130, 130, 50, 20}, "button", 0);
+    index.updateWindow(1, {200, 150, 400, 300});
+
+    Index::Hit hit;
+    CHECK(index.hitTest(240, 190, 0, 1, hit) && *hit.payload == "button");
+    CHECK(hit.frame.x == 230 && hit.frame.y == 180);
+    CHECK(!index.hitTest(140, 140, 0, 1, hit));
+    CHECK(index.getStats().windowMoves == 1);
+}
+
+TEST(windowResizeDropsEntries) {
+    Index index(1000, 8, 4, 64);
+    index.insert(1, 10, kWindow, {130, 130, 50, 20}, "button", 0);
+    index.updateWindow(1, {100, 100, 500, 300});
+
+    Index::Hit hit;
+    CHECK(!index.hitTest(140, 140, 0, 1, hit));
+    CHECK(index.getStats().windowResets == 1);
+    CHECK(index.getStats().windows == 1);
+}
+
+TEST(topmostWindowOccludesLower) {
+    Index index(1000, 8, 4, 64);
+    index.insert(1, 10, {0, 0, 400, 400}, {10, 10, 20, 20}, "below", 0);
+    index.insert(2, 10, {0, 0, 100, 100}, {50, 50, 20, 20}, "above", 1);
+
+    // Window 2 covers (15, 15) but knows nothing there; window 1 is hidden
+    Index::Hit hit;
+    CHECK(!index.hitTest(15, 15, 0, 2, hit));
+    CHECK(hitPayload(index, 55, 55, 2, "above"));
+
+    index.raiseWindow(1, 3);
+    CHECK(hitPayload(index, 15, 15, 3, "below"));
+
+    // Window 1 now hides window 2's element until it goes away
+    CHECK(!index.hitTest(55, 55, 0, 3, hit));
+    index.removeWindow(1);
+    CHECK(hitPayload(index, 55, 55, 4, "above"));
+}
+
+TEST(ttlExpiry) {
+    Index index(1000, 8, 4, 64);
+    index.insert(1, 10, kWindow, {130, 130, 50, 20}, "button", 0);
+
+    CHECK(hitPayload(index, 140, 140, 1000, "button"));
+    Index::Hit hit;
+    CHECK(!index.hitTest(140, 140, 0, 1001, hit));
+    CHECK(index.getStats().staleMisses == 1);
+}
+
+TEST(acceptRejectsOtherElements) {
+    Index index(1000, 8, 4, 64);
+    index.insert(1, 10, kWindow, {120, 120, 200, 100}, "group", 0);
+    index.insert(1, 10, kWindow, {130, 130, 50, 20}, "button", 0);
+
+    // The element actually at the point is an unindexed child of the group
+    Index::Hit hit;
+    auto isChild = [](const std::string& payload) { return payload == "child"; };
+    CHECK(!index.hitTest(140, 140, 0, 1, isChild, hit));
+    CHECK(index.getStats().staleMisses == 1);
+
+    // A container can still match when it is the element at the point
+    auto isGroup = [](const std::string& payload) { return payload == "group"; };
+    CHECK(index.hitTest(140, 140, 0, 1, isGroup, hit) && *hit.payload == "group");
+    CHECK(hit.frame.width == 200);
+}
+
+TEST(resetWindowAtDropsScrolledContent) {
+    Index index(1000, 8, 4, 64);
+    index.insert(1, 10, kWindow, {130, 130, 50, 20}, "a", 0);
+    index.insert(2, 11, {600, 100, 200, 200}, {610, 110, 20, 20}, "b", 1);
+
+    CHECK(index.resetWindowAt(150, 150));
+    Index::Hit hit;
+    CHECK(!index.hitTest(140, 140, 0, 2, hit));
+    CHECK(hitPayload(index, 615, 115, 2, "b"));
+    CHECK(index.getStats().windows == 2);
+    CHECK(!index.resetWindowAt(5, 5));
+}
+
+TEST(removeOwnerDropsAllItsWindows) {
+    Index index(1000, 8, 4, 64);
+    index.insert(1, 10, kWindow, {130, 130, 50, 20}, "a", 0);
+    index.insert(2, 10, {600, 100, 200, 200}, {610, 110, 20, 20}, "b", 1);
+    index.insert(3, 11, {900, 100, 200, 200}, {910, 110, 20, 20}, "c", 2);
+
+    index.removeOwner(10);
+    CHECK(index.getStats().windows == 1);
+    CHECK(hitPayload(index, 915, 115, 3, "c"));
+}
+
+TEST(clearWindowKeepsOtherWindows) {
+    Index index(1000, 8, 4, 64);
+    index.insert(1, 10, kWindow, {130, 130, 50, 20}, "a", 0);
+    index.insert(2, 10, {600, 100, 200, 200}, {610, 110, 20, 20}, "b", 1);
+
+    CHECK(index.clearWindow(1));
+    Index::Hit hit;
+    CHECK(!index.hitTest(140, 140, 0, 2, hit));
+    CHECK(hitPayload(index, 615, 115, 2, "b"));
+    CHECK(index.getStats().windows == 2);
+    CHECK(!index.clearWindow(3));
+}
+
+TEST(removeEntriesDropsOnlyMatchingElements) {
+    Index index(1000, 8, 4, 16);
+    index.insert(1, 10, kWindow, {130, 130, 50, 20}, "field", 0);
+    index.insert(1, 10, kWindow, {200, 130, 50, 20}, "button", 0);
+    index.insert(2, 11, {600, 100, 200, 200}, {610, 110, 20, 20}, "field", 1);
+
+    auto isField = [](const std::string& payload) { return payload == "field"; };
+    CHECK(index.removeEntries(10, isField) == 1);
+    CHECK(index.getStats().evictions == 1);
+
+    // The grid is rebuilt, so the remaining entry is still found
+    Index::Hit hit;
+    CHECK(!index.hitTest(140, 140, 0, 2, hit));
+    CHECK(hitPayload(index, 210, 140, 2, "button"));
+    CHECK(hitPayload(index, 615, 115, 2, "field")); // Other owner untouched
+}
+
+TEST(windowAndElementLimits) {
+    Index index(1000, 8, 2, 64);
+    index.insert(1, 10, {0, 0, 100, 100}, {10, 10, 10, 10}, "a", 0);
+    index.insert(2, 10, {200, 0, 100, 100}, {210, 10, 10, 10}, "b", 1);
+    index.insert(3, 10, {400, 0, 100, 100}, {410, 10, 10, 10}, "c", 2);
+    CHECK(index.getStats().windows == 2);
+    Index::Hit hit;
+    CHECK(!index.hitTest(15, 15, 0, 3, hit)); // Least recent window evicted
+
+    for (int i = 0; i < 20; i++) {
+        index.insert(3, 10, {400, 0, 100, 100}, {400 + i * 4, 50, 4, 4}, "x" + std::to_string(i), 10 + i);
+    }
+    CHECK(index.getStats().elements <= 8 + 2);
+    CHECK(hitPayload(index, 477, 51, 30, "x19"));
+}
+
+TEST(elementsOutsideWindowAreIgnored) {
+    Index index(1000, 8, 4, 64);
+    index.insert(1, 10, kWindow, {10, 10, 20, 20}, "outside", 0);
+    index.insert(1, 10, kWindow, {0, 0, 0, 0}, "empty", 0);
+    CHECK(index.getStats().elements == 0);
+}
+
+RUN_TESTS()
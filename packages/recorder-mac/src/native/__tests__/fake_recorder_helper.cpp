@@ -0,0 +1,98 @@
+// Stand-in for ax_recorder_helper in the client tests: same arguments and
+// command protocol, but it pushes synthetic steps instead of capturing input.
+// The session id chooses the behaviour:
+//   "deny"  reply error, as when the taps cannot be created
+//   "hang"  never reply
+//   "crash" push the steps, then abort
+// Anything else replies ok and pushes FAKE_HELPER_STEPS steps (default 1000).
+
+#include "recorder_helper_client.h"
+#include "step_codec.h"
+#include "step_ring.h"
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <unistd.h>
+
+static void reply(int fd, const char* line) {
+    ssize_t written = write(fd, line, strlen(line));
+    (void)written;
+}
+
+int main(int argc, char** argv) {
+    int ringFd = -1;
+    int wakeFd = -1;
+    int replyFd = -1;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string flag = argv[i];
+        if (flag == "--ring-fd") {
+            ringFd = std::atoi(argv[i + 1]);
+        } else if (flag == "--wake-fd") {
+            wakeFd = std::atoi(argv[i + 1]);
+        } else if (flag == "--reply-fd") {
+            replyFd = std::atoi(argv[i + 1]);
+        }
+    }
+
+    std::unique_ptr<StepRing> ring = StepRing::fromFd(ringFd);
+    if (!ring || wakeFd < 0 || replyFd < 0) {
+        return 1;
+    }
+    std::unique_ptr<WakeChannel> wake = WakeChannel::fromFd(wakeFd);
+    const char* configured = std::getenv("FAKE_HELPER_STEPS");
+    int count = configured ? std::atoi(configured) : 1000;
+
+    std::string pending;
+    char buffer[256];
+    ssize_t received;
+    while ((received = read(STDIN_FILENO, buffer, sizeof(buffer))) > 0) {
+        pending.append(buffer, static_cast<size_t>(received));
+
+        size_t newline;
+        while ((newline = pending.find('\n')) != std::string::npos) {
+            std::string command = pending.substr(0, newline);
+            pending.erase(0, newline + 1);
+
+            if (command == "stop") {
+                reply(replyFd, "ok\n");
+                continue;
+            }
+            if (command.compare(0, 6, "start ") != 0) {
+                reply(replyFd, "error\n");
+                continue;
+            }
+
+            std::string session = command.substr(6);
+            if (session == "deny") {
+                reply(replyFd, "error\n");
+                continue;
+            }
+            if (session == "hang") {
+                continue;
+            }
+
+            reply(replyFd, "ok\n");
+            RecordedStep step;
+            step.sessionId = session;
+            step.action = "click";
+            step.button = "left";
+            step.targetDescriptor.role = "AXButton";
+            step.targetDescriptor.title = "OK";
+            step.targetDescriptor.frame = {1, 2, 3, 4};
+            step.appInfo = {"Finder", 42};
+            std::string encoded;
+            for (int i = 0; i < count; i++) {
+                step.timestamp = i;
+                encodeStep(step, encoded);
+                while (!ring->push(encoded.data(), encoded.size(), wake.get())) {
+                    usleep(50);
+                }
+            }
+            ring->setCounter(kHelperPrefetchHits, 7);
+            if (session == "crash") {
+                std::abort();
+            }
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,120 @@
+// Flow throughput as lanes and pool threads grow. Work steps burn CPU in
+// place on the pool; input steps hand off to a fake app thread per lane and
+// complete asynchronously, like the JS-driven steps FlowRunner schedules.
+//
+//   flow_scheduler_bench [flows=160]
+
+#include "flow_scheduler.h"
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+static void burn(int micros) {
+    auto until = std::chrono::steady_clock::now() + std::chrono::microseconds(micros);
+    volatile unsigned sink = 0;
+    while (std::chrono::steady_clock::now() < until) {
+        for (int i = 0; i < 100; i++) {
+            sink = sink * 31 + static_cast<unsigned>(i);
+        }
+    }
+}
+
+// One thread per app that "types" for a while and then reports back
+class FakeApp {
+public:
+    FakeApp() : stopping(false), thread(&FakeApp::run, this) {}
+    ~FakeApp() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_one();
+        thread.join();
+    }
+
+    void post(int micros, StepDone done) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            queue.emplace_back(micros, std::move(done));
+        }
+        wake.notify_one();
+    }
+
+private:
+    void run() {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            wake.wait(lock, [this] { return stopping || !queue.empty(); });
+            if (queue.empty()) {
+                return;
+            }
+            std::pair<int, StepDone> input = std::move(queue.front());
+            queue.pop_front();
+            lock.unlock();
+            std::this_thread::sleep_for(std::chrono::microseconds(input.first));
+            input.second(true);
+            lock.lock();
+        }
+    }
+
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::deque<std::pair<int, StepDone>> queue;
+    bool stopping;
+    std::thread thread;
+};
+
+int main(int argc, char** argv) {
+    int flows = argc > 1 ? std::atoi(argv[1]) : 160;
+    std::printf("%d flows of work 2 ms, input 1 ms, work 2 ms, input 1 ms\n", flows);
+
+    for (int laneCount : {1, 4, 16}) {
+        for (size_t threads : {1, 2, 4, 8}) {
+            std::map<std::string, std::unique_ptr<FakeApp>> apps;
+            for (int i = 0; i < laneCount; i++) {
+                apps["app" + std::to_string(i)].reset(new FakeApp());
+            }
+
+            auto startedAt = std::chrono::steady_clock::now();
+            {
+                FlowScheduler scheduler(threads);
+                for (int f = 0; f < flows; f++) {
+                    FakeApp* app = apps["app" + std::to_string(f % laneCount)].get();
+                    ScheduledStep compute;
+                    compute.native = true;
+                    compute.start = [](uint64_t, size_t, StepDone done) {
+                        burn(2000);
+                        done(true);
+                    };
+                    ScheduledStep input;
+                    input.kind = StepKind::Input;
+                    input.app = "app" + std::to_string(f % laneCount);
+                    input.start = [app](uint64_t, size_t, StepDone done) {
+                        app->post(1000, std::move(done));
+                    };
+
+                    FlowSpec spec;
+                    spec.steps = {compute, input, compute, input};
+                    scheduler.submit(std::move(spec));
+                }
+                scheduler.waitAll();
+
+                double elapsed = std::chrono::duration<double, std::milli>(
+                    std::chrono::steady_clock::now() - startedAt).count();
+                SchedulerStats stats = scheduler.getStats();
+                std::printf("lanes %2d, threads %zu: %6.0f ms, %6.0f flows/s, %llu steals\n",
+                            laneCount, threads, elapsed, flows * 1000.0 / elapsed,
+                            static_cast<unsigned long long>(stats.pool.steals));
+            }
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,341 @@
+#include "flow_scheduler.h"
+#include "step_broker.h"
+#include "test_support.h"
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Fake backend: input steps record which apps are being driven at once
+struct AppMonitor {
+    std::mutex mutex;
+    std::map<std::string, int> busy;
+    std::atomic<int> overlaps{0};
+
+    ScheduledStep input(const std::string& app, int micros) {
+        ScheduledStep step;
+        step.kind = StepKind::Input;
+        step.app = app;
+        step.start = [this, app, micros](uint64_t, size_t, StepDone done) {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (busy[app]++ > 0) {
+                    overlaps++;
+                }
+            }
+            std::this_thread::sleep_for(std::chrono::microseconds(micros));
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                busy[app]--;
+            }
+            done(true);
+        };
+        return step;
+    }
+};
+
+static ScheduledStep work(int micros, bool ok = true) {
+    ScheduledStep step;
+    step.native = true;
+    step.start = [micros, ok](uint64_t, size_t, StepDone done) {
+        std::this_thread::sleep_for(std::chrono::microseconds(micros));
+        if (!ok) {
+            throw std::runtime_error("step failed");
+        }
+        done(true);
+    };
+    return step;
+}
+
+// Steps that go through a broker, as FlowRunner's do
+static ScheduledStep brokered(StepBroker& broker, StepKind kind, const std::string& app) {
+    ScheduledStep step;
+    step.kind = kind;
+    step.app = app;
+    step.start = [&broker](uint64_t flowId, size_t stepIndex, StepDone done) {
+        broker.call(flowId, stepIndex, std::move(done));
+    };
+    return step;
+}
+
+template <typename Predicate>
+static bool waitFor(Predicate predicate, int timeoutMs = 5000) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+    while (!predicate()) {
+        if (std::chrono::steady_clock::now() > deadline) {
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::microseconds(200));
+    }
+    return true;
+}
+
+TEST(randomFlowsKeepAppsExclusive) {
+    static const char* const kApps[] = {"Mail", "Safari", "Notes", "Finder"};
+    AppMonitor monitor;
+    FlowScheduler scheduler(4);
+    std::mt19937 random(1);
+    std::map<uint64_t, bool> expectFailure;
+    std::map<uint64_t, bool> cancelled;
+
+    for (int f = 0; f < 400; f++) {
+        FlowSpec spec;
+        spec.name = "flow " + std::to_string(f);
+        size_t steps = 1 + random() % 6;
+        bool failing = random() % 10 == 0;
+        for (size_t i = 0; i < steps; i++) {
+            if (random() % 2) {
+                spec.steps.push_back(monitor.input(kApps[random() % 4], 50 + random() % 100));
+            } else {
+                spec.steps.push_back(work(50 + random() % 100, !(failing && i + 1 == steps)));
+            }
+        }
+        bool fails = failing && spec.steps.back().kind == StepKind::Work;
+        uint64_t id = scheduler.submit(std::move(spec));
+        expectFailure[id] = fails;
+        if (f % 37 == 0) {
+            scheduler.cancel(id);
+            cancelled[id] = true;
+        }
+    }
+    scheduler.waitAll();
+
+    std::vector<FlowTiming> timings;
+    CHECK(scheduler.takeFinished(timings) == 400);
+    for (const FlowTiming& timing : timings) {
+        if (timing.cancelled) {
+            CHECK(cancelled[timing.flowId] && !timing.ok);
+        } else {
+            CHECK(timing.ok == !expectFailure[timing.flowId]);
+            CHECK(!timing.timedOut);
+        }
+    }
+    CHECK(monitor.overlaps == 0);
+
+    SchedulerStats stats = scheduler.getStats();
+    CHECK(stats.flowsSubmitted == 400 && stats.flowsFinished == 400);
+    CHECK(stats.lanes == 4 && stats.runningFlows == 0 && stats.waitingFlows == 0);
+}
+
+TEST(brokeredStepsCompleteFromAnotherThread) {
+    StepBroker broker;
+    FlowScheduler scheduler(3);
+    std::atomic<bool> stop{false};
+
+    // Stands in for the JS poller; step 2 of odd flows fails
+    std::thread poller([&] {
+        std::vector<StepBroker::Call> calls;
+        while (!stop) {
+            if (broker.take(calls, 64) == 0) {
+                std::this_thread::sleep_for(std::chrono::microseconds(200));
+                continue;
+            }
+            for (const StepBroker::Call& call : calls) {
+                CHECK(broker.complete(call.callId, !(call.flowId % 2 == 1 && call.stepIndex == 2)));
+            }
+        }
+    });
+
+    for (int f = 0; f < 200; f++) {
+        FlowSpec spec;
+        std::string app = "app" + std::to_string(f % 3);
+        for (int i = 0; i < 4; i++) {
+            spec.steps.push_back(brokered(broker, i % 2 ? StepKind::Input : StepKind::Work, app));
+        }
+        scheduler.submit(std::move(spec));
+    }
+    scheduler.waitAll();
+    stop = true;
+    poller.join();
+
+    std::vector<FlowTiming> timings;
+    CHECK(scheduler.takeFinished(timings) == 200);
+    int failed = 0;
+    for (const FlowTiming& timing : timings) {
+        if (!timing.ok) {
+            failed++;
+            CHECK(timing.flowId % 2 == 1 && timing.stepsRun == 3);
+        } else {
+            CHECK(timing.stepsRun == 4);
+        }
+    }
+    CHECK(failed == 100);
+}
+
+TEST(pendingStepsHoldNoThreads) {
+    // Far more outstanding steps than threads: all of them must still reach
+    // the broker, because nothing waits for a step on a scheduler thread
+    StepBroker broker;
+    FlowScheduler scheduler(2);
+    for (int f = 0; f < 64; f++) {
+        FlowSpec spec;
+        std::string app = "app" + std::to_string(f);
+        spec.steps.push_back(brokered(broker, f % 2 ? StepKind::Input : StepKind::Work, app));
+        scheduler.submit(std::move(spec));
+    }
+
+    std::vector<StepBroker::Call> calls;
+    std::vector<StepBroker::Call> taken;
+    CHECK(waitFor([&] {
+        broker.take(calls, 64);
+        taken.insert(taken.end(), calls.begin(), calls.end());
+        return taken.size() == 64;
+    }));
+    CHECK(scheduler.getStats().runningFlows == 64);
+
+    for (const StepBroker::Call& call : taken) {
+        CHECK(broker.complete(call.callId, true));
+    }
+    scheduler.waitAll();
+    CHECK(scheduler.getStats().flowsFinished == 64);
+}
+
+TEST(timedOutFlowKeepsLanesUntilStepIsDone) {
+    StepBroker broker;
+    FlowScheduler scheduler(2, 20);
+
+    FlowSpec first;
+    first.name = "first";
+    first.steps.push_back(brokered(broker, StepKind::Input, "Mail"));
+    first.steps.push_back(brokered(broker, StepKind::Input, "Mail"));
+    uint64_t firstId = scheduler.submit(std::move(first));
+    FlowSpec second;
+    second.steps.push_back(brokered(broker, StepKind::Input, "Mail"));
+    uint64_t secondId = scheduler.submit(std::move(second));
+
+    std::vector<StepBroker::Call> calls;
+    CHECK(broker.take(calls, 8) == 1 && calls[0].flowId == firstId);
+    uint64_t stuck = calls[0].callId;
+
+    CHECK(scheduler.expireSteps() == 0);
+    std::this_thread::sleep_for(std::chrono::milliseconds(30));
+    CHECK(scheduler.expireSteps() == 1);
+    CHECK(scheduler.expireSteps() == 0);
+
+    // Reported at once...
+    std::vector<FlowTiming> timings;
+    CHECK(scheduler.takeFinished(timings) == 1);
+    CHECK(timings[0].flowId == firstId && timings[0].timedOut && !timings[0].ok && timings[0].stepsRun == 0);
+
+    // ...but Mail stays with the stuck step
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    CHECK(broker.take(calls, 8) == 0);
+    SchedulerStats stats = scheduler.getStats();
+    CHECK(stats.abandonedFlows == 1 && stats.waitingFlows == 1 && stats.runningFlows == 0);
+
+    // Once it is done the first flow stops and the second gets the lane
+    CHECK(broker.complete(stuck, true));
+    CHECK(broker.take(calls, 8) == 1 && calls[0].flowId == secondId);
+    CHECK(broker.complete(calls[0].callId, true));
+    scheduler.waitAll();
+
+    CHECK(scheduler.takeFinished(timings) == 1);
+    CHECK(timings[0].flowId == secondId && timings[0].ok);
+    CHECK(scheduler.getStats().flowsFinished == 2);
+}
+
+TEST(closingBrokerFailsOutstandingSteps) {
+    StepBroker broker;
+    FlowScheduler scheduler(2);
+    for (int f = 0; f < 20; f++) {
+        FlowSpec spec;
+        spec.steps.push_back(brokered(broker, StepKind::Input, "app" + std::to_string(f % 3)));
+        spec.steps.push_back(brokered(broker, StepKind::Work, ""));
+        scheduler.submit(std::move(spec));
+    }
+
+    std::vector<StepBroker::Call> calls;
+    CHECK(waitFor([&] { return broker.take(calls, 2) == 2; }));
+    broker.close();
+    scheduler.waitAll();
+
+    CHECK(!broker.complete(calls[0].callId, true));
+    std::vector<FlowTiming> timings;
+    CHECK(scheduler.takeFinished(timings) == 20);
+    for (const FlowTiming& timing : timings) {
+        CHECK(!timing.ok);
+    }
+}
+
+TEST(poolStartsOnlyForNativeWork) {
+    StepBroker broker;
+    FlowScheduler scheduler(2);
+    for (int f = 0; f < 20; f++) {
+        FlowSpec spec;
+        spec.steps = {brokered(broker, StepKind::Work, ""), brokered(broker, StepKind::Input, "Mail")};
+        scheduler.submit(std::move(spec));
+    }
+
+    // Handed-off steps are started inline and leave the pool unbuilt
+    std::vector<StepBroker::Call> calls;
+    CHECK(waitFor([&] {
+        broker.take(calls, 64);
+        for (const StepBroker::Call& call : calls) {
+            broker.complete(call.callId, true);
+        }
+        return scheduler.getStats().flowsFinished == 20;
+    }));
+    SchedulerStats stats = scheduler.getStats();
+    CHECK(stats.workSteps == 20 && stats.pool.threads == 0 && stats.pool.executed == 0);
+
+    FlowSpec spec;
+    spec.steps = {work(10)};
+    scheduler.submit(std::move(spec));
+    scheduler.waitAll();
+    stats = scheduler.getStats();
+    CHECK(stats.pool.threads == 2 && stats.pool.executed == 1);
+}
+
+TEST(synchronousStepsDoNotRecurse) {
+    // Each step finishes inside its start; a recursive advance would need
+    // a stack frame per step
+    FlowScheduler scheduler(1);
+    FlowSpec spec;
+    for (int i = 0; i < 200000; i++) {
+        ScheduledStep step;
+        step.kind = StepKind::Input;
+        step.app = "Mail";
+        step.start = [](uint64_t, size_t, StepDone done) { done(true); };
+        spec.steps.push_back(std::move(step));
+    }
+    scheduler.submit(std::move(spec));
+    scheduler.waitAll();
+
+    std::vector<FlowTiming> timings;
+    CHECK(scheduler.takeFinished(timings) == 1);
+    CHECK(timings[0].ok && timings[0].stepsRun == 200000);
+    CHECK(scheduler.getStats().inputSteps == 200000);
+}
+
+TEST(throwingStepFailsFlow) {
+    FlowScheduler scheduler(1);
+    FlowSpec spec;
+    spec.steps.push_back(work(10, false));
+    spec.steps.push_back(work(10));
+    scheduler.submit(std::move(spec));
+    scheduler.waitAll();
+
+    std::vector<FlowTiming> timings;
+    CHECK(scheduler.takeFinished(timings) == 1);
+    CHECK(!timings[0].ok && timings[0].stepsRun == 1);
+}
+
+TEST(destructorCancelsQueuedFlows) {
+    AppMonitor monitor;
+    {
+        FlowScheduler scheduler(2);
+        for (int i = 0; i < 50; i++) {
+            FlowSpec spec;
+            spec.steps = {monitor.input("A", 200), work(200), monitor.input("A", 200)};
+            scheduler.submit(std::move(spec));
+        }
+    }
+    CHECK(monitor.overlaps == 0);
+}
+
+RUN_TESTS()
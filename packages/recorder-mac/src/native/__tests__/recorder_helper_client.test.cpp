@@ -0,0 +1,137 @@
+#include "recorder_helper_client.h"
+#include "test_support.h"
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <thread>
+
+// Built by CMake next to this test; see fake_recorder_helper.cpp
+#ifndef FAKE_HELPER_PATH
+#error "FAKE_HELPER_PATH must point at the fake_recorder_helper executable"
+#endif
+
+using Clock = std::chrono::steady_clock;
+
+template <typename Predicate>
+static bool waitFor(Predicate predicate, int timeoutMs = 5000) {
+    auto deadline = Clock::now() + std::chrono::milliseconds(timeoutMs);
+    while (!predicate()) {
+        if (Clock::now() > deadline) {
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    }
+    return true;
+}
+
+struct Collector {
+    std::atomic<int> steps{0};
+    std::atomic<bool> ordered{true};
+    long long last = -1;
+
+    StepCallback callback() {
+        return [this](const RecordedStep& step) {
+            if (step.timestamp != last + 1) {
+                ordered = false;
+            }
+            last = step.timestamp;
+            steps++;
+        };
+    }
+};
+
+TEST(startIsConfirmedWithoutBlocking) {
+    setenv("FAKE_HELPER_STEPS", "20000", 1);
+    Collector collector;
+    RecorderHelperClient client(FAKE_HELPER_PATH, EventFilter(), collector.callback());
+    CHECK(client.isAlive());
+
+    auto startedAt = Clock::now();
+    CHECK(client.startRecording("session"));
+    CHECK(Clock::now() - startedAt < std::chrono::milliseconds(50));
+
+    CHECK(waitFor([&] { return !client.isCommandPending(); }));
+    CHECK(client.isRecordingActive());
+    CHECK(!client.startRecording("again")); // Already recording
+
+    CHECK(waitFor([&] { return collector.steps == 20000; }));
+    CHECK(collector.ordered);
+    CHECK(waitFor([&] { return client.counter(kHelperPrefetchHits) == 7; }));
+}
+
+TEST(stopDeliversEarlierStepsBeforeSettling) {
+    setenv("FAKE_HELPER_STEPS", "50000", 1);
+    Collector collector;
+    RecorderHelperClient client(FAKE_HELPER_PATH, EventFilter(), collector.callback());
+    CHECK(client.startRecording("session"));
+    CHECK(waitFor([&] { return !client.isCommandPending(); }));
+
+    // The stop reply comes after every push, so once it settles nothing is left
+    client.stopRecording();
+    CHECK(!client.isRecordingActive());
+    CHECK(waitFor([&] { return !client.isCommandPending(); }));
+    CHECK(collector.steps == 50000);
+    CHECK(collector.ordered);
+}
+
+TEST(startErrorIsReported) {
+    Collector collector;
+    RecorderHelperClient client(FAKE_HELPER_PATH, EventFilter(), collector.callback());
+    CHECK(client.startRecording("deny"));
+    CHECK(waitFor([&] { return !client.isCommandPending(); }));
+    CHECK(!client.isRecordingActive());
+    CHECK(client.isAlive());
+}
+
+TEST(controlCharactersInSessionIdAreRejected) {
+    setenv("FAKE_HELPER_STEPS", "10", 1);
+    Collector collector;
+    RecorderHelperClient client(FAKE_HELPER_PATH, EventFilter(), collector.callback());
+
+    // Sent unchecked, "deny" would arrive as a second command with its own reply
+    CHECK(!client.startRecording("session\nstart deny"));
+    CHECK(!client.startRecording(std::string("session\0", 8)));
+    CHECK(!client.startRecording("session\r"));
+    CHECK(!client.isCommandPending());
+
+    CHECK(client.startRecording("session-\xc3\xa9")); // UTF-8 is fine
+    CHECK(waitFor([&] { return !client.isCommandPending(); }));
+    CHECK(client.isRecordingActive());
+    CHECK(waitFor([&] { return collector.steps == 10; }));
+}
+
+TEST(unresponsiveHelperDoesNotBlockCaller) {
+    Collector collector;
+    RecorderHelperClient client(FAKE_HELPER_PATH, EventFilter(), collector.callback());
+
+    auto startedAt = Clock::now();
+    CHECK(client.startRecording("hang"));
+    client.stopRecording();
+    CHECK(Clock::now() - startedAt < std::chrono::milliseconds(50));
+    CHECK(client.isCommandPending());
+    CHECK(!client.startRecording("next")); // Still waiting on the helper
+}
+
+TEST(helperCrashEndsRecording) {
+    setenv("FAKE_HELPER_STEPS", "1000", 1);
+    Collector collector;
+    RecorderHelperClient client(FAKE_HELPER_PATH, EventFilter(), collector.callback());
+    CHECK(client.startRecording("crash"));
+
+    CHECK(waitFor([&] { return !client.isAlive(); }));
+    CHECK(!client.isRecordingActive());
+    CHECK(!client.isCommandPending());
+    CHECK(!client.startRecording("again"));
+    // Steps published before the crash were still delivered
+    CHECK(collector.steps == 1000);
+}
+
+TEST(missingHelperFailsCleanly) {
+    Collector collector;
+    RecorderHelperClient client("/nonexistent/ax_recorder_helper", EventFilter(), collector.callback());
+    CHECK(!client.isAlive());
+    CHECK(!client.startRecording("session"));
+    CHECK(!client.isCommandPending());
+}
+
+RUN_TESTS()
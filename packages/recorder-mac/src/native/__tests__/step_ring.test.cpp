@@ -0,0 +1,203 @@
+#include "step_codec.h"
+#include "step_ring.h"
+#include "test_support.h"
+#include <cerrno>
+#include <chrono>
+#include <fcntl.h>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+static std::string ringName(const char* suffix) {
+    return "/axrec-test-" + std::to_string(getpid()) + "-" + suffix;
+}
+
+static RecordedStep sampleStep() {
+    RecordedStep step;
+    step.timestamp = 123456789012LL;
+    step.sessionId = "session";
+    step.action = "type";
+    step.text = "h\xC3\xA9llo\n";
+    step.location = {-5, 7};
+    step.modifiers.shift = true;
+    step.modifiers.command = true;
+    step.targetDescriptor.role = "AXTextField";
+    step.targetDescriptor.title = "Name";
+    step.targetDescriptor.identifier = "name-field";
+    step.targetDescriptor.value = "value";
+    step.targetDescriptor.frame = {1, 2, 3, 4};
+    step.targetDescriptor.ancestry = {"AXWindow", "AXGroup"};
+    step.appInfo = {"Safari", 99};
+    return step;
+}
+
+TEST(codecRoundTrip) {
+    RecordedStep step = sampleStep();
+    std::string encoded;
+    encodeStep(step, encoded);
+
+    RecordedStep decoded;
+    CHECK(decodeStep(reinterpret_cast<const uint8_t*>(encoded.data()), encoded.size(), decoded));
+    CHECK(decoded.timestamp == step.timestamp);
+    CHECK(decoded.sessionId == "session" && decoded.action == "type" && decoded.text == step.text);
+    CHECK(decoded.location.x == -5 && decoded.location.y == 7);
+    CHECK(decoded.modifiers.shift && decoded.modifiers.command && !decoded.modifiers.option);
+    CHECK(decoded.targetDescriptor.identifier == "name-field");
+    CHECK(decoded.targetDescriptor.frame.height == 4);
+    CHECK(decoded.targetDescriptor.ancestry.size() == 2 && decoded.targetDescriptor.ancestry[1] == "AXGroup");
+    CHECK(decoded.appInfo.name == "Safari" && decoded.appInfo.processId == 99);
+}
+
+TEST(codecRejectsTruncatedRecords) {
+    std::string encoded;
+    encodeStep(sampleStep(), encoded);
+
+    RecordedStep decoded;
+    for (size_t cut = 0; cut < encoded.size(); cut++) {
+        CHECK(!decodeStep(reinterpret_cast<const uint8_t*>(encoded.data()), cut, decoded));
+    }
+}
+
+TEST(nameIsUnlinkedOnCreate) {
+    std::string name = ringName("unlink");
+    std::unique_ptr<StepRing> ring = StepRing::create(name, 4096);
+    CHECK(ring != nullptr);
+    CHECK(ring->descriptor() >= 0);
+
+    // Nothing is left behind for a crashed process to leak
+    errno = 0;
+    CHECK(shm_open(name.c_str(), O_RDWR, 0600) < 0 && errno == ENOENT);
+
+    // The name can be reused at once
+    CHECK(StepRing::create(name, 4096) != nullptr);
+}
+
+TEST(ringWrapsAndCountsDrops) {
+    std::unique_ptr<StepRing> ring = StepRing::create(ringName("wrap"), 4096);
+    std::string record(300, 'x');
+    std::string out;
+
+    int resident = 0;
+    while (ring->push(record.data(), record.size(), nullptr)) {
+        resident++;
+    }
+    CHECK(resident > 0);
+    CHECK(ring->dropped() == 1);
+
+    // Keep the ring full while positions wrap many times
+    for (int round = 0; round < 1000; round++) {
+        record[0] = static_cast<char>(round);
+        CHECK(ring->pop(out));
+        CHECK(ring->push(record.data(), record.size(), nullptr));
+    }
+
+    int popped = 0;
+    char last = 0;
+    while (ring->pop(out)) {
+        CHECK(out.size() == 300);
+        last = out[0];
+        popped++;
+    }
+    CHECK(popped == resident);
+    CHECK(last == static_cast<char>(999));
+    CHECK(ring->dropped() == 1);
+}
+
+TEST(oversizedRecordIsDropped) {
+    std::unique_ptr<StepRing> ring = StepRing::create(ringName("large"), 4096);
+    std::string record(4096, 'x');
+    CHECK(!ring->push(record.data(), record.size(), nullptr));
+    CHECK(ring->dropped() == 1);
+}
+
+TEST(forkedProducerDeliversInOrder) {
+    const int steps = 200000;
+    std::unique_ptr<StepRing> ring = StepRing::create(ringName("fork"), 1 << 16);
+    std::unique_ptr<WakeChannel> wake = WakeChannel::create();
+
+    pid_t pid = fork();
+    if (pid == 0) {
+        // The producer gets the segment the way the helper does: by descriptor
+        std::unique_ptr<StepRing> producer = StepRing::fromFd(ring->descriptor());
+        std::unique_ptr<WakeChannel> signal = WakeChannel::fromFd(wake->writeFd());
+        RecordedStep step = sampleStep();
+        std::string encoded;
+        for (int i = 0; i < steps; i++) {
+            step.timestamp = i;
+            encodeStep(step, encoded);
+            while (!producer->push(encoded.data(), encoded.size(), signal.get())) {
+                usleep(20);
+            }
+        }
+        producer->setCounter(3, 77);
+        _exit(0);
+    }
+    ring->closeDescriptor();
+    wake->closeWriteEnd();
+
+    std::string out;
+    RecordedStep step;
+    long long expected = 0;
+    bool ordered = true;
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(30);
+    while (expected < steps && std::chrono::steady_clock::now() < deadline) {
+        if (!ring->pop(out)) {
+            ring->waitForData(*wake, 200);
+            continue;
+        }
+        ordered = ordered && decodeStep(reinterpret_cast<const uint8_t*>(out.data()), out.size(), step) &&
+                  step.timestamp == expected;
+        expected++;
+    }
+
+    int status = 0;
+    waitpid(pid, &status, 0);
+    CHECK(expected == steps);
+    CHECK(ordered);
+    CHECK(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    CHECK(ring->counter(3) == 77);
+}
+
+TEST(pageRoundedSegmentIsAccepted) {
+    std::unique_ptr<StepRing> ring = StepRing::create(ringName("rounded"), 1 << 16);
+    CHECK(ring != nullptr);
+
+    // macOS reports the segment rounded up to its 16 KiB pages
+    struct stat info;
+    CHECK(fstat(ring->descriptor(), &info) == 0);
+    CHECK(ftruncate(ring->descriptor(), info.st_size + 12288) == 0);
+
+    std::unique_ptr<StepRing> producer = StepRing::fromFd(dup(ring->descriptor()));
+    CHECK(producer != nullptr);
+    const char record[] = "rounded";
+    CHECK(producer->push(record, sizeof(record), nullptr));
+    std::string out;
+    CHECK(ring->pop(out) && out == std::string(record, sizeof(record)));
+
+    // A segment too small for the capacity in its header is still refused
+    CHECK(ftruncate(ring->descriptor(), 4096 + 4096) == 0);
+    CHECK(StepRing::fromFd(dup(ring->descriptor())) == nullptr);
+}
+
+TEST(waitReturnsForOtherDescriptor) {
+    std::unique_ptr<StepRing> ring = StepRing::create(ringName("other"), 4096);
+    std::unique_ptr<WakeChannel> wake = WakeChannel::create();
+    int fds[2];
+    CHECK(pipe(fds) == 0);
+
+    auto startedAt = std::chrono::steady_clock::now();
+    CHECK(!ring->waitForData(*wake, 50, fds[0]));
+    CHECK(std::chrono::steady_clock::now() - startedAt >= std::chrono::milliseconds(40));
+
+    CHECK(write(fds[1], "x", 1) == 1);
+    startedAt = std::chrono::steady_clock::now();
+    CHECK(ring->waitForData(*wake, 5000, fds[0]));
+    CHECK(std::chrono::steady_clock::now() - startedAt < std::chrono::milliseconds(1000));
+
+    close(fds[0]);
+    close(fds[1]);
+}
+
+RUN_TESTS()
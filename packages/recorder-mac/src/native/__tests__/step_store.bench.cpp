@@ -0,0 +1,109 @@
+// Step history at scale: write, open and first-page query latency over a
+// multi-segment store, against a full scan of the same steps.
+//
+//   step_store_bench [steps=4000000] [segmentSteps=65536]
+
+#include "step_store.h"
+#include "step_store_fixture.h"
+#include "temp_file.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+using namespace step_store_fixture;
+using Clock = std::chrono::steady_clock;
+
+static double millisSince(Clock::time_point startedAt) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - startedAt).count();
+}
+
+int main(int argc, char** argv) {
+    size_t steps = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 4000000;
+    size_t segmentSteps = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 65536;
+
+    TempDirectory directory;
+    std::mt19937 random(7);
+    std::string error;
+
+    Clock::time_point startedAt = Clock::now();
+    if (!writeHistory(directory.path(), steps, segmentSteps, random, error)) {
+        std::printf("write failed: %s\n", error.c_str());
+        return 1;
+    }
+    double writeMillis = millisSince(startedAt);
+
+    StepStore store;
+    startedAt = Clock::now();
+    if (!store.open(directory.path(), error)) {
+        std::printf("open failed: %s\n", error.c_str());
+        return 1;
+    }
+    double openMillis = millisSince(startedAt);
+    StepStoreStats stats = store.stats();
+    std::printf("%llu steps in %zu segments, %.0f MB mapped\n",
+                static_cast<unsigned long long>(stats.steps), stats.segments, stats.mappedBytes / 1e6);
+    std::printf("write %.0f ms (%.0f ns/step), open %.2f ms\n",
+                writeMillis, writeMillis * 1e6 / static_cast<double>(steps), openMillis);
+
+    std::vector<double> latencies;
+    std::vector<double> selective;
+    size_t searched = 0;
+    size_t skipped = 0;
+    for (int round = 0; round < 1000; round++) {
+        StepQuery query = randomQuery(random, stats.minTimestamp, stats.maxTimestamp);
+        StepPage page;
+        startedAt = Clock::now();
+        store.query(query, page, error);
+        double millis = millisSince(startedAt);
+        latencies.push_back(millis);
+        if (!query.terms[kStepFieldIdentifier].empty()) {
+            selective.push_back(millis);
+        }
+        searched += page.segmentsSearched;
+        skipped += page.segmentsSkipped;
+    }
+    std::sort(latencies.begin(), latencies.end());
+    std::sort(selective.begin(), selective.end());
+    std::printf("first page, 1000 random queries: p50 %.3f ms, p99 %.3f ms, max %.3f ms; "
+                "%.1f segments searched, %.1f skipped per query\n",
+                latencies[latencies.size() / 2], latencies[latencies.size() * 99 / 100], latencies.back(),
+                searched / 1000.0, skipped / 1000.0);
+    if (!selective.empty()) {
+        std::printf("  with an identifier term: p50 %.3f ms, p99 %.3f ms\n",
+                    selective[selective.size() / 2], selective[selective.size() * 99 / 100]);
+    }
+
+    // Reference: decode every step and filter, as a store without indexes would
+    StepQuery scan;
+    scan.limit = 1 << 20;
+    StepQuery needle;
+    needle.terms[kStepFieldIdentifier] = {"id1234"};
+    needle.terms[kStepFieldApp] = {"Mail"};
+    size_t matched = 0;
+    size_t decoded = 0;
+    StepPage page;
+    startedAt = Clock::now();
+    do {
+        store.query(scan, page, error);
+        for (const RecordedStep& step : page.steps) {
+            matched += step.targetDescriptor.identifier == "id1234" && step.appInfo.name == "Mail";
+        }
+        decoded += page.steps.size();
+        scan.hasCursor = true;
+        scan.after = page.next;
+    } while (page.hasMore);
+    double scanMillis = millisSince(startedAt);
+
+    std::vector<RecordedStep> found;
+    StepQuery indexed = needle;
+    indexed.limit = 1 << 20;
+    startedAt = Clock::now();
+    store.query(indexed, page, error);
+    double indexedMillis = millisSince(startedAt);
+    std::printf("app + identifier, all matches: full scan of %zu steps %.0f ms, indexed %.3f ms (%zu / %zu matches)\n",
+                decoded, scanMillis, indexedMillis, matched, page.steps.size());
+    return 0;
+}
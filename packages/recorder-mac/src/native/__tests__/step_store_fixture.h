@@ -0,0 +1,87 @@
+#pragma once
+
+// Synthetic recording history shared by the step store test and benchmark
+
+#include "step_store.h"
+#include <random>
+#include <string>
+
+namespace step_store_fixture {
+
+static const char* const kApps[] = {"Mail", "Safari", "Notes", "Finder", "Slack", "Xcode", "Terminal", "Calendar"};
+static const char* const kActions[] = {"click", "type", "drag"};
+
+// Mostly clicks, eight apps, 30 roles, 2000 identifiers, a session per 100 s
+inline RecordedStep makeStep(std::mt19937& random, long long timestamp) {
+    RecordedStep step;
+    step.timestamp = timestamp;
+    step.sessionId = "s" + std::to_string(timestamp / 100000);
+    step.action = kActions[random() % 10 < 7 ? 0 : (random() % 2 ? 1 : 2)];
+    step.text = step.action == "type" ? "hello" : "";
+    step.location = {static_cast<int>(random() % 1440), static_cast<int>(random() % 900)};
+    step.targetDescriptor.role = "AXRole" + std::to_string(random() % 30);
+    step.targetDescriptor.identifier = "id" + std::to_string(random() % 2000);
+    step.targetDescriptor.title = "Title";
+    step.targetDescriptor.frame = {1, 2, 3, 4};
+    step.targetDescriptor.ancestry = {"AXApplication", "AXWindow"};
+    step.appInfo.name = kApps[random() % 8];
+    step.appInfo.processId = 100;
+    return step;
+}
+
+// Two writers with different segment sizes and slightly out-of-order
+// timestamps, so segments overlap in time as they do with several recorders
+inline bool writeHistory(const std::string& directory, size_t steps, size_t segmentSteps,
+                         std::mt19937& random, std::string& error) {
+    StepStoreWriter first(segmentSteps);
+    StepStoreWriter second(segmentSteps / 3 + 1);
+    if (!first.open(directory, error) || !second.open(directory, error)) {
+        return false;
+    }
+    long long timestamp = 1700000000000LL;
+    for (size_t i = 0; i < steps; i++) {
+        timestamp += random() % 50;
+        RecordedStep step = makeStep(random, timestamp - static_cast<long long>(random() % 200));
+        if (!(i % 3 ? first : second).append(step, error)) {
+            return false;
+        }
+    }
+    return first.flush(error) && second.flush(error);
+}
+
+// A query mixing a time range with any combination of field terms
+inline StepQuery randomQuery(std::mt19937& random, long long minTimestamp, long long maxTimestamp) {
+    StepQuery query;
+    query.newestFirst = random() % 2;
+    query.limit = 1 + random() % 200;
+    long long span = maxTimestamp - minTimestamp + 1;
+    if (random() % 2) {
+        query.from = minTimestamp + static_cast<long long>(random() % static_cast<unsigned long long>(span));
+        query.until = query.from + static_cast<long long>(random() % static_cast<unsigned long long>(span / (1 + random() % 50) + 1));
+    }
+    if (random() % 2) {
+        query.terms[kStepFieldApp] = {kApps[random() % 8]};
+    }
+    if (random() % 3 == 0) {
+        query.terms[kStepFieldApp].push_back(kApps[random() % 8]);
+    }
+    if (random() % 2) {
+        query.terms[kStepFieldAction] = {kActions[random() % 3]};
+    }
+    if (random() % 2) {
+        query.terms[kStepFieldRole] = {"AXRole" + std::to_string(random() % 30), "AXRole" + std::to_string(random() % 30)};
+    }
+    if (random() % 4 == 0) {
+        query.terms[kStepFieldIdentifier] = {"id" + std::to_string(random() % 2000)};
+    }
+    if (random() % 8 == 0) {
+        long long sessionAt = minTimestamp + static_cast<long long>(random() % static_cast<unsigned long long>(span));
+        query.terms[kStepFieldSession] = {"s" + std::to_string(sessionAt / 100000)};
+    }
+    if (random() % 10 == 0) {
+        query.terms[kStepFieldApp] = {"Nope"};
+    }
+    return query;
+}
+
+} // namespace step_store_fixture
@@ -0,0 +1,87 @@
+#pragma once
+
+// Scratch files and directories for tests and benchmarks, removed when the
+// object goes away
+
+#include <cstdio>
+#include <cstdlib>
+#include <dirent.h>
+#include <string>
+#include <unistd.h>
+
+inline std::string tempBase() {
+    const char* base = std::getenv("TMPDIR");
+    return base && *base ? base : "/tmp";
+}
+
+class TempFile {
+public:
+    // `suffix` keeps the extension CsvReader uses to pick a delimiter
+    explicit TempFile(const std::string& suffix = "") {
+        std::string pattern = tempBase() + "/native-test-XXXXXX" + suffix;
+        int fd = mkstemps(&pattern[0], static_cast<int>(suffix.size()));
+        if (fd >= 0) {
+            close(fd);
+            filePath = pattern;
+        }
+    }
+    ~TempFile() {
+        if (!filePath.empty()) {
+            unlink(filePath.c_str());
+        }
+    }
+    TempFile(const TempFile&) = delete;
+    TempFile& operator=(const TempFile&) = delete;
+
+    const std::string& path() const { return filePath; }
+
+    bool write(const std::string& contents) const {
+        FILE* file = std::fopen(filePath.c_str(), "wb");
+        if (!file) {
+            return false;
+        }
+        bool ok = std::fwrite(contents.data(), 1, contents.size(), file) == contents.size();
+        return std::fclose(file) == 0 && ok;
+    }
+
+private:
+    std::string filePath;
+};
+
+// A flat directory; files written into it are removed with it
+class TempDirectory {
+public:
+    TempDirectory() {
+        std::string pattern = tempBase() + "/native-test-XXXXXX";
+        if (mkdtemp(&pattern[0])) {
+            directoryPath = pattern;
+        }
+    }
+    ~TempDirectory() {
+        clear();
+        if (!directoryPath.empty()) {
+            rmdir(directoryPath.c_str());
+        }
+    }
+    TempDirectory(const TempDirectory&) = delete;
+    TempDirectory& operator=(const TempDirectory&) = delete;
+
+    const std::string& path() const { return directoryPath; }
+
+    void clear() const {
+        DIR* dir = directoryPath.empty() ? nullptr : opendir(directoryPath.c_str());
+        if (!dir) {
+            return;
+        }
+        while (dirent* entry = readdir(dir)) {
+            std::string name = entry->d_name;
+            if (name != "." && name != "..") {
+                unlink((directoryPath + "/" + name).c_str());
+            }
+        }
+        closedir(dir);
+    }
+
+private:
+    std::string directoryPath;
+};
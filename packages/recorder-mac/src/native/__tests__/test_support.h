@@ -0,0 +1,75 @@
+#pragma once
+
+// Minimal test harness for the native code: TEST() registers a case, CHECK()
+// records a failure and keeps going, and RUN_TESTS() runs every case and
+// exits non-zero if any check failed. No third-party framework is needed.
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+namespace native_test {
+
+struct TestCase {
+    const char* name;
+    void (*run)();
+};
+
+inline std::vector<TestCase>& registry() {
+    static std::vector<TestCase> cases;
+    return cases;
+}
+
+inline int& failures() {
+    static int count = 0;
+    return count;
+}
+
+struct Registrar {
+    Registrar(const char* name, void (*run)()) {
+        registry().push_back({name, run});
+    }
+};
+
+inline int runAll(int argc, char** argv) {
+    // An optional argument runs only the cases whose name contains it
+    const char* filter = argc > 1 ? argv[1] : nullptr;
+    int ran = 0;
+    for (const TestCase& test : registry()) {
+        if (filter && std::string(test.name).find(filter) == std::string::npos) {
+            continue;
+        }
+        int before = failures();
+        auto startedAt = std::chrono::steady_clock::now();
+        test.run();
+        long long millis = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - startedAt).count();
+        std::printf("%s %s (%lld ms)\n", failures() == before ? "PASS" : "FAIL", test.name, millis);
+        ran++;
+    }
+    std::printf("%d tests, %d failed checks\n", ran, failures());
+    return failures() == 0 && ran > 0 ? 0 : 1;
+}
+
+} // namespace native_test
+
+#define TEST(name)                                                          \
+    static void name();                                                     \
+    static native_test::Registrar name##Registrar(#name, name);             \
+    static void name()
+
+#define CHECK(condition)                                                    \
+    do {                                                                    \
+        if (!(condition)) {                                                 \
+            std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n",               \
+                         __FILE__, __LINE__, #condition);                   \
+            native_test::failures()++;                                      \
+        }                                                                   \
+    } while (0)
+
+#define RUN_TESTS()                                                         \
+    int main(int argc, char** argv) {                                       \
+        return native_test::runAll(argc, argv);                             \
+    }
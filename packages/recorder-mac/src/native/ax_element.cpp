@@ -1,4 +1,5 @@
 #include "ax_element.h"
+#include "event_monitor.h"
 #include <ApplicationServices/ApplicationServices.h>
 #include <iostream>
 
@@ -111,6 +112,24 @@ std::vector<std::string> AXElementInfo::getAncestryPath() {
     return path;
 }
 
+void AXElementInfo::describe(TargetDescriptor& descriptor, bool includeRole) {
+    if (includeRole) {
+        descriptor.role = getStringAttribute(kAXRoleAttribute);
+    }
+    descriptor.title = getStringAttribute(kAXTitleAttribute);
+    descriptor.identifier = getStringAttribute(kAXIdentifierAttribute);
+    descriptor.value = getStringAttribute(kAXValueAttribute);
+    descriptor.ancestry = getAncestryPath();
+    
+    CGRect frame = getFrame();
+    descriptor.frame = {
+        static_cast<int>(frame.origin.x),
+        static_cast<int>(frame.origin.y),
+        static_cast<int>(frame.size.width),
+        static_cast<int>(frame.size.height)
+    };
+}
+
 std::string AXElementInfo::getStringAttributeForElement(AXUIElementRef elem, CFStringRef attribute) {
     if (!elem) return "";
     
@@ -163,6 +182,7 @@ AXUIElementRef AXElementInfo::getElementAtPoint(CGPoint point) {
     return nullptr;
 }
 
+#ifndef AX_RECORDER_HELPER
 Napi::Object AXElementInfo::toJSON(Napi::Env env) {
     Napi::Object obj = Napi::Object::New(env);
     
@@ -189,4 +209,5 @@ Napi::Object AXElementInfo::toJSON(Napi::Env env) {
     obj.Set("ancestry", ancestryArray);
     
     return obj;
-}
\ No newline at end of file
+}
+#endif
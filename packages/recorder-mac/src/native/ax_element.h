@@ -1,10 +1,50 @@
 #pragma once
 
+#ifndef AX_RECORDER_HELPER
 #include <napi.h>
+#endif
 #include <ApplicationServices/ApplicationServices.h>
 #include <string>
+#include <utility>
 #include <vector>
 
+struct TargetDescriptor;
+
+// Retained AXUIElementRef that can be copied into caches
+class AXElementHandle {
+public:
+    AXElementHandle() : element(nullptr) {}
+    explicit AXElementHandle(AXUIElementRef elem) : element(elem) {
+        if (element) {
+            CFRetain(element);
+        }
+    }
+    AXElementHandle(const AXElementHandle& other) : AXElementHandle(other.element) {}
+    AXElementHandle(AXElementHandle&& other) : element(other.element) {
+        other.element = nullptr;
+    }
+    ~AXElementHandle() {
+        if (element) {
+            CFRelease(element);
+        }
+    }
+    
+    AXElementHandle& operator=(AXElementHandle other) {
+        std::swap(element, other.element);
+        return *this;
+    }
+    
+    AXUIElementRef get() const { return element; }
+    
+    // AX hands out a fresh ref per query; CFEqual compares the underlying element
+    bool matches(AXUIElementRef other) const {
+        return element && other && CFEqual(element, other);
+    }
+    
+private:
+    AXUIElementRef element;
+};
+
 class AXElementInfo {
 public:
     AXElementInfo();
@@ -20,14 +60,19 @@ public:
         }
     }
     
+    AXUIElementRef getElement() const { return element; }
+    
     std::string getStringAttribute(CFStringRef attribute);
     CGRect getFrame();
     std::vector<std::string> getAncestryPath();
+    void describe(TargetDescriptor& descriptor, bool includeRole = true);
     
     static AXUIElementRef getElementAtPoint(CGPoint point);
     static std::string getStringAttributeForElement(AXUIElementRef elem, CFStringRef attribute);
     
+#ifndef AX_RECORDER_HELPER
     Napi::Object toJSON(Napi::Env env);
+#endif
     
 private:
     AXUIElementRef element;
@@ -1,6 +1,12 @@
 #include <napi.h>
 #include "event_monitor.h"
-#include <iostream>
+#include "flow_batch.h"
+#include "flow_runner.h"
+#include "hover_prefetcher.h"
+#include "recorder_helper_client.h"
+#include "step_history.h"
+#include "step_js.h"
+#include <memory>
 #include <queue>
 #include <mutex>
 
@@ -8,20 +14,32 @@ class AXRecorder : public Napi::ObjectWrap<AXRecorder> {
 public:
     static Napi::Object Init(Napi::Env env, Napi::Object exports);
     AXRecorder(const Napi::CallbackInfo& info);
+    ~AXRecorder();
     
     Napi::Value StartRecording(const Napi::CallbackInfo& info);
     Napi::Value StopRecording(const Napi::CallbackInfo& info);
     Napi::Value IsRecording(const Napi::CallbackInfo& info);
+    Napi::Value IsPending(const Napi::CallbackInfo& info);
     Napi::Value GetRecordedSteps(const Napi::CallbackInfo& info);
     Napi::Value ClearSteps(const Napi::CallbackInfo& info);
+    Napi::Value GetTapStats(const Napi::CallbackInfo& info);
+    Napi::Value GetPrefetchStats(const Napi::CallbackInfo& info);
+    Napi::Value GetIndexStats(const Napi::CallbackInfo& info);
 
 private:
     void OnStepRecorded(const RecordedStep& step);
-    Napi::Object RecordedStepToJS(Napi::Env env, const RecordedStep& step);
+    static bool FilterFromJS(const Napi::Object& options, EventFilter& filter, std::string& error);
+    
+    TapStats CollectTapStats() const;
+    PrefetchStats CollectPrefetchStats() const;
+    ElementIndexStats CollectIndexStats() const;
     
     std::queue<RecordedStep> recordedSteps;
     std::mutex stepsMutex;
     EventMonitor* monitor;
+    SubscriptionId subscriptionId;
+    // Set when the pipeline runs in the ax_recorder_helper process instead
+    std::unique_ptr<RecorderHelperClient> helper;
 };
 
 Napi::Object AXRecorder::Init(Napi::Env env, Napi::Object exports) {
@@ -29,8 +47,12 @@ Napi::Object AXRecorder::Init(Napi::Env env, Napi::Object exports) {
         InstanceMethod("startRecording", &AXRecorder::StartRecording),
         InstanceMethod("stopRecording", &AXRecorder::StopRecording),
         InstanceMethod("isRecording", &AXRecorder::IsRecording),
+        InstanceMethod("isPending", &AXRecorder::IsPending),
         InstanceMethod("getRecordedSteps", &AXRecorder::GetRecordedSteps),
-        InstanceMethod("clearSteps", &AXRecorder::ClearSteps)
+        InstanceMethod("clearSteps", &AXRecorder::ClearSteps),
+        InstanceMethod("getTapStats", &AXRecorder::GetTapStats),
+        InstanceMethod("getPrefetchStats", &AXRecorder::GetPrefetchStats),
+        InstanceMethod("getIndexStats", &AXRecorder::GetIndexStats)
     });
     
     Napi::FunctionReference* constructor = new Napi::FunctionReference();
@@ -41,13 +63,124 @@ Napi::Object AXRecorder::Init(Napi::Env env, Napi::Object exports) {
     return exports;
 }
 
-AXRecorder::AXRecorder(const Napi::CallbackInfo& info) : Napi::ObjectWrap<AXRecorder>(info) {
-    monitor = EventMonitor::getInstance();
+AXRecorder::AXRecorder(const Napi::CallbackInfo& info) :
+    Napi::ObjectWrap<AXRecorder>(info),
+    monitor(EventMonitor::getInstance()),
+    subscriptionId(0) {
+    
+    EventFilter filter;
+    std::string error;
+    if (info.Length() > 0 && info[0].IsObject() && !FilterFromJS(info[0].As<Napi::Object>(), filter, error)) {
+        Napi::TypeError::New(info.Env(), error).ThrowAsJavaScriptException();
+        return;
+    }
     
-    // Set up callback for recorded steps
-    monitor->setStepCallback([this](const RecordedStep& step) {
+    StepCallback callback = [this](const RecordedStep& step) {
         this->OnStepRecorded(step);
-    });
+    };
+    
+    if (info.Length() > 1 && info[1].IsObject()) {
+        Napi::Object options = info[1].As<Napi::Object>();
+        bool outOfProcess = options.Has("outOfProcess") && options.Get("outOfProcess").IsBoolean() &&
+                            options.Get("outOfProcess").As<Napi::Boolean>().Value();
+        
+        if (outOfProcess) {
+            if (!options.Has("helperPath") || !options.Get("helperPath").IsString()) {
+                Napi::TypeError::New(info.Env(), "helperPath string expected for out-of-process recording").ThrowAsJavaScriptException();
+                return;
+            }
+            
+            std::string helperPath = options.Get("helperPath").As<Napi::String>().Utf8Value();
+            helper.reset(new RecorderHelperClient(helperPath, filter, callback));
+            return;
+        }
+    }
+    
+    // Each recorder is its own subscriber; the monitor fans events out to all of them
+    subscriptionId = monitor->subscribe(filter, callback);
+}
+
+AXRecorder::~AXRecorder() {
+    if (helper) {
+        helper.reset();
+    } else if (subscriptionId != 0) {
+        // Zero when the constructor threw before subscribing
+        monitor->unsubscribe(subscriptionId);
+    }
+}
+
+bool AXRecorder::FilterFromJS(const Napi::Object& options, EventFilter& filter, std::string& error) {
+    if (options.Has("actions") && !options.Get("actions").IsUndefined()) {
+        if (!options.Get("actions").IsArray()) {
+            error = "actions must be an array";
+            return false;
+        }
+        Napi::Array actions = options.Get("actions").As<Napi::Array>();
+        // An empty list is treated like an omitted one and matches every action
+        uint32_t mask = actions.Length() == 0 ? kStepActionAll : 0;
+        for (uint32_t i = 0; i < actions.Length(); i++) {
+            Napi::Value value = actions.Get(i);
+            std::string action = value.IsString() ? value.As<Napi::String>().Utf8Value() : "";
+            if (action == "click") {
+                mask |= kStepActionClick;
+            } else if (action == "type") {
+                mask |= kStepActionType;
+            } else if (action == "drag") {
+                mask |= kStepActionDrag;
+            } else {
+                error = "actions must contain only 'click', 'type' or 'drag'";
+                return false;
+            }
+        }
+        filter.actionMask = mask;
+    }
+    
+    if (options.Has("appName") && options.Get("appName").IsString()) {
+        filter.appName = options.Get("appName").As<Napi::String>().Utf8Value();
+    }
+    
+    if (options.Has("processId") && options.Get("processId").IsNumber()) {
+        filter.processId = options.Get("processId").As<Napi::Number>().Int32Value();
+    }
+    
+    if (options.Has("roles") && !options.Get("roles").IsUndefined()) {
+        if (!options.Get("roles").IsArray()) {
+            error = "roles must be an array of strings";
+            return false;
+        }
+        Napi::Array roles = options.Get("roles").As<Napi::Array>();
+        for (uint32_t i = 0; i < roles.Length(); i++) {
+            if (!roles.Get(i).IsString()) {
+                error = "roles must be an array of strings";
+                return false;
+            }
+            filter.roles.push_back(roles.Get(i).As<Napi::String>().Utf8Value());
+        }
+    }
+    
+    if (options.Has("region") && !options.Get("region").IsUndefined()) {
+        if (!options.Get("region").IsObject()) {
+            error = "region must be an object with x, y, width and height";
+            return false;
+        }
+        Napi::Object region = options.Get("region").As<Napi::Object>();
+        const char* fields[] = {"x", "y", "width", "height"};
+        for (const char* field : fields) {
+            if (!region.Get(field).IsNumber()) {
+                error = "region must be an object with x, y, width and height";
+                return false;
+            }
+        }
+        filter.hasRegion = true;
+        filter.region = {
+            region.Get("x").As<Napi::Number>().Int32Value(),
+            region.Get("y").As<Napi::Number>().Int32Value(),
+            region.Get("width").As<Napi::Number>().Int32Value(),
+            region.Get("height").As<Napi::Number>().Int32Value()
+        };
+    }
+    
+    return true;
 }
 
 Napi::Value AXRecorder::StartRecording(const Napi::CallbackInfo& info) {
@@ -60,21 +193,33 @@ Napi::Value AXRecorder::StartRecording(const Napi::CallbackInfo& info) {
     
     std::string sessionId = info[0].As<Napi::String>().Utf8Value();
     
-    bool success = monitor->startRecording(sessionId);
+    bool success = helper ? helper->startRecording(sessionId)
+                          : monitor->startRecording(subscriptionId, sessionId);
     return Napi::Boolean::New(env, success);
 }
 
 Napi::Value AXRecorder::StopRecording(const Napi::CallbackInfo& info) {
     Napi::Env env = info.Env();
     
-    monitor->stopRecording();
+    if (helper) {
+        helper->stopRecording();
+    } else {
+        monitor->stopRecording(subscriptionId);
+    }
     return Napi::Boolean::New(env, true);
 }
 
 Napi::Value AXRecorder::IsRecording(const Napi::CallbackInfo& info) {
     Napi::Env env = info.Env();
     
-    return Napi::Boolean::New(env, monitor->isRecordingActive());
+    return Napi::Boolean::New(env, helper ? helper->isRecordingActive() : monitor->isRecordingActive(subscriptionId));
+}
+
+Napi::Value AXRecorder::IsPending(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    
+    // Only the helper answers asynchronously; in process every call completes inline
+    return Napi::Boolean::New(env, helper ? helper->isCommandPending() : false);
 }
 
 Napi::Value AXRecorder::GetRecordedSteps(const Napi::CallbackInfo& info) {
@@ -106,70 +251,111 @@ Napi::Value AXRecorder::ClearSteps(const Napi::CallbackInfo& info) {
     return Napi::Boolean::New(env, true);
 }
 
-void AXRecorder::OnStepRecorded(const RecordedStep& step) {
-    std::cout << "OnStepRecorded called with action: " << step.action << std::endl;
-    std::lock_guard<std::mutex> lock(stepsMutex);
-    recordedSteps.push(step);
-    std::cout << "Step added to queue, queue size now: " << recordedSteps.size() << std::endl;
+Napi::Value AXRecorder::GetTapStats(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    
+    TapStats stats = CollectTapStats();
+    
+    Napi::Object obj = Napi::Object::New(env);
+    obj.Set("timeoutRecoveries", Napi::Number::New(env, static_cast<double>(stats.timeoutRecoveries)));
+    obj.Set("userInputRecoveries", Napi::Number::New(env, static_cast<double>(stats.userInputRecoveries)));
+    obj.Set("lastRecoveryAt", Napi::Number::New(env, static_cast<double>(stats.lastRecoveryAt)));
+    
+    return obj;
 }
 
-Napi::Object AXRecorder::RecordedStepToJS(Napi::Env env, const RecordedStep& step) {
+Napi::Value AXRecorder::GetPrefetchStats(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    
+    PrefetchStats stats = CollectPrefetchStats();
+    
     Napi::Object obj = Napi::Object::New(env);
+    obj.Set("prefetches", Napi::Number::New(env, static_cast<double>(stats.prefetches)));
+    obj.Set("hits", Napi::Number::New(env, static_cast<double>(stats.hits)));
+    obj.Set("misses", Napi::Number::New(env, static_cast<double>(stats.misses)));
+    obj.Set("staleHits", Napi::Number::New(env, static_cast<double>(stats.staleHits)));
+    obj.Set("hitLatencyMicros", Napi::Number::New(env, static_cast<double>(stats.hitLatencyMicros)));
+    obj.Set("missLatencyMicros", Napi::Number::New(env, static_cast<double>(stats.missLatencyMicros)));
+    obj.Set("savedMicros", Napi::Number::New(env, static_cast<double>(stats.savedMicros)));
     
-    obj.Set("timestamp", Napi::Number::New(env, step.timestamp));
-    obj.Set("sessionId", Napi::String::New(env, step.sessionId));
-    obj.Set("action", Napi::String::New(env, step.action));
+    return obj;
+}
+
+Napi::Value AXRecorder::GetIndexStats(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
     
-    if (!step.button.empty()) {
-        obj.Set("button", Napi::String::New(env, step.button));
-    }
+    ElementIndexStats stats = CollectIndexStats();
+    
+    Napi::Object obj = Napi::Object::New(env);
+    obj.Set("hits", Napi::Number::New(env, static_cast<double>(stats.hits)));
+    obj.Set("misses", Napi::Number::New(env, static_cast<double>(stats.misses)));
+    obj.Set("staleMisses", Napi::Number::New(env, static_cast<double>(stats.staleMisses)));
+    obj.Set("inserts", Napi::Number::New(env, static_cast<double>(stats.inserts)));
+    obj.Set("windowMoves", Napi::Number::New(env, static_cast<double>(stats.windowMoves)));
+    obj.Set("windowResets", Napi::Number::New(env, static_cast<double>(stats.windowResets)));
+    obj.Set("evictions", Napi::Number::New(env, static_cast<double>(stats.evictions)));
+    obj.Set("elements", Napi::Number::New(env, static_cast<double>(stats.elements)));
+    obj.Set("windows", Napi::Number::New(env, static_cast<double>(stats.windows)));
     
-    if (!step.text.empty()) {
-        obj.Set("text", Napi::String::New(env, step.text));
+    return obj;
+}
+
+TapStats AXRecorder::CollectTapStats() const {
+    if (!helper) {
+        return monitor->getTapStats();
     }
     
-    Napi::Object location = Napi::Object::New(env);
-    location.Set("x", Napi::Number::New(env, step.location.x));
-    location.Set("y", Napi::Number::New(env, step.location.y));
-    obj.Set("location", location);
-    
-    Napi::Object modifiers = Napi::Object::New(env);
-    modifiers.Set("shift", Napi::Boolean::New(env, step.modifiers.shift));
-    modifiers.Set("control", Napi::Boolean::New(env, step.modifiers.control));
-    modifiers.Set("option", Napi::Boolean::New(env, step.modifiers.option));
-    modifiers.Set("command", Napi::Boolean::New(env, step.modifiers.command));
-    obj.Set("modifiers", modifiers);
-    
-    Napi::Object target = Napi::Object::New(env);
-    target.Set("role", Napi::String::New(env, step.targetDescriptor.role));
-    target.Set("title", Napi::String::New(env, step.targetDescriptor.title));
-    target.Set("identifier", Napi::String::New(env, step.targetDescriptor.identifier));
-    target.Set("value", Napi::String::New(env, step.targetDescriptor.value));
-    
-    Napi::Object frame = Napi::Object::New(env);
-    frame.Set("x", Napi::Number::New(env, step.targetDescriptor.frame.x));
-    frame.Set("y", Napi::Number::New(env, step.targetDescriptor.frame.y));
-    frame.Set("width", Napi::Number::New(env, step.targetDescriptor.frame.width));
-    frame.Set("height", Napi::Number::New(env, step.targetDescriptor.frame.height));
-    target.Set("frame", frame);
-    
-    Napi::Array ancestry = Napi::Array::New(env, step.targetDescriptor.ancestry.size());
-    for (size_t i = 0; i < step.targetDescriptor.ancestry.size(); i++) {
-        ancestry[i] = Napi::String::New(env, step.targetDescriptor.ancestry[i]);
+    TapStats stats;
+    stats.timeoutRecoveries = helper->counter(kHelperTapTimeoutRecoveries);
+    stats.userInputRecoveries = helper->counter(kHelperTapUserInputRecoveries);
+    stats.lastRecoveryAt = static_cast<long long>(helper->counter(kHelperTapLastRecoveryAt));
+    return stats;
+}
+
+PrefetchStats AXRecorder::CollectPrefetchStats() const {
+    if (!helper) {
+        return monitor->getPrefetchStats();
     }
-    target.Set("ancestry", ancestry);
-    obj.Set("targetDescriptor", target);
     
-    Napi::Object appInfo = Napi::Object::New(env);
-    appInfo.Set("name", Napi::String::New(env, step.appInfo.name));
-    appInfo.Set("processId", Napi::Number::New(env, step.appInfo.processId));
-    obj.Set("appInfo", appInfo);
+    PrefetchStats stats;
+    stats.prefetches = helper->counter(kHelperPrefetches);
+    stats.hits = helper->counter(kHelperPrefetchHits);
+    stats.misses = helper->counter(kHelperPrefetchMisses);
+    stats.staleHits = helper->counter(kHelperPrefetchStaleHits);
+    stats.hitLatencyMicros = helper->counter(kHelperPrefetchHitLatencyMicros);
+    stats.missLatencyMicros = helper->counter(kHelperPrefetchMissLatencyMicros);
+    stats.savedMicros = helper->counter(kHelperPrefetchSavedMicros);
+    return stats;
+}
+
+ElementIndexStats AXRecorder::CollectIndexStats() const {
+    if (!helper) {
+        return monitor->getIndexStats();
+    }
     
-    return obj;
+    ElementIndexStats stats;
+    stats.hits = helper->counter(kHelperIndexHits);
+    stats.misses = helper->counter(kHelperIndexMisses);
+    stats.staleMisses = helper->counter(kHelperIndexStaleMisses);
+    stats.inserts = helper->counter(kHelperIndexInserts);
+    stats.windowMoves = helper->counter(kHelperIndexWindowMoves);
+    stats.windowResets = helper->counter(kHelperIndexWindowResets);
+    stats.evictions = helper->counter(kHelperIndexEvictions);
+    stats.elements = static_cast<size_t>(helper->counter(kHelperIndexElements));
+    stats.windows = static_cast<size_t>(helper->counter(kHelperIndexWindows));
+    return stats;
+}
+
+void AXRecorder::OnStepRecorded(const RecordedStep& step) {
+    std::lock_guard<std::mutex> lock(stepsMutex);
+    recordedSteps.push(step);
 }
 
 Napi::Object Init(Napi::Env env, Napi::Object exports) {
-    return AXRecorder::Init(env, exports);
+    AXRecorder::Init(env, exports);
+    InitFlowBatch(env, exports);
+    InitFlowRunner(env, exports);
+    return InitStepHistory(env, exports);
 }
 
 NODE_API_MODULE(ax_recorder, Init)
\ No newline at end of file
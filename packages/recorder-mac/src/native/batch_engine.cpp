@@ -0,0 +1,324 @@
+#include "batch_engine.h"
+#include <algorithm>
+#include <chrono>
+
+BatchEngine::BatchEngine()
+  : queueCapacity(256),
+    skipRows(0),
+    stopRequested(false),
+    pendingBase(0),
+    nextRow(0),
+    nextOffset(0) {
+}
+
+BatchEngine::~BatchEngine() {
+    cancel();
+}
+
+long long BatchEngine::nowNanos() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+bool BatchEngine::start(const BatchConfig& config, std::string& error) {
+    if (parser.joinable()) {
+        error = "Batch already started";
+        return false;
+    }
+
+    reader = CsvReader::open(config.path, config.delimiter);
+    if (!reader) {
+        error = "Cannot open table file: " + config.path;
+        return false;
+    }
+
+    std::vector<std::string_view> fields;
+    if (!reader->readRow(fields)) {
+        error = "Table file has no header row: " + config.path;
+        return false;
+    }
+
+    TemplateScope scope;
+    scope.rowPrefixes = {"row"};
+    if (!config.tableVariable.empty()) {
+        scope.rowPrefixes.push_back(config.tableVariable);
+    }
+    header.clear();
+    for (std::string_view field : fields) {
+        // First occurrence wins for duplicate column names
+        scope.columns.emplace(std::string(field), static_cast<uint32_t>(header.size()));
+        header.emplace_back(field);
+    }
+
+    for (const auto& variable : config.variables) {
+        scope.variables[variable.first] = variable.second;
+    }
+
+    templates.clear();
+    slotList.clear();
+    for (size_t i = 0; i < config.steps.size(); i++) {
+        const BatchStepTemplate& step = config.steps[i];
+        const std::pair<bool, const std::string*> sources[] = {
+            {step.hasSelector, &step.selector},
+            {step.hasText, &step.text},
+            {step.hasUrl, &step.url}
+        };
+        for (uint8_t field = kBatchSelector; field <= kBatchUrl; field++) {
+            if (!sources[field].first) {
+                continue;
+            }
+            FlowTemplate compiled;
+            if (!compiled.compile(*sources[field].second, scope, error)) {
+                error = "Step " + std::to_string(i) + ": " + error;
+                return false;
+            }
+            templates.push_back(std::move(compiled));
+            slotList.push_back({static_cast<uint32_t>(i), static_cast<BatchField>(field)});
+        }
+    }
+
+    // Resume: seek to a known row boundary, or count rows from the header.
+    // Until the skipped rows are behind us the checkpoint stays the one we
+    // were given; offset 0 still means "skip startRow rows".
+    nextOffset = reader->bytesConsumed();
+    skipRows = 0;
+    if (config.startOffset > 0) {
+        if (!reader->seek(config.startOffset)) {
+            error = "Cannot seek to checkpoint offset " + std::to_string(config.startOffset);
+            return false;
+        }
+        nextOffset = config.startOffset;
+    } else if (config.startRow > 0) {
+        skipRows = config.startRow;
+        nextOffset = 0;
+    }
+    nextRow = config.startRow;
+    pendingBase = config.startRow;
+    pending.clear();
+    queue.clear();
+
+    queueCapacity = config.queueCapacity > 0 ? config.queueCapacity : 1;
+    stats = BatchProgress();
+    stats.totalBytes = reader->fileSize();
+    stats.bytesRead = reader->bytesConsumed();
+    stopRequested = false;
+
+    parser = std::thread(&BatchEngine::run, this);
+    return true;
+}
+
+void BatchEngine::cancel() {
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        stopRequested = true;
+    }
+    queueSpace.notify_all();
+    if (parser.joinable()) {
+        parser.join();
+    }
+}
+
+void BatchEngine::bind(const std::vector<std::string_view>& fields, BoundRow& row) {
+    row.values.clear();
+    row.ends.clear();
+    for (const FlowTemplate& compiled : templates) {
+        compiled.render(fields, row.values);
+        row.ends.push_back(static_cast<uint32_t>(row.values.size()));
+    }
+}
+
+void BatchEngine::run() {
+    std::vector<std::string_view> fields;
+    std::vector<BoundRow> batch;
+    std::vector<BoundRow> recycled;
+    std::vector<Pending> batchPending;
+    uint64_t skipped = 0;
+    long long lastAt = nowNanos();
+
+    while (!stopRequested) {
+        if (!reader->readRow(fields)) {
+            break;
+        }
+
+        if (skipped < skipRows) {
+            if (++skipped == skipRows) {
+                std::lock_guard<std::mutex> lock(queueMutex);
+                nextOffset = reader->bytesConsumed();
+                stats.bytesRead = nextOffset;
+            }
+            lastAt = nowNanos();
+            continue;
+        }
+
+        if (recycled.empty()) {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            recycled.swap(spare);
+        }
+        BoundRow row;
+        if (!recycled.empty()) {
+            row = std::move(recycled.back());
+            recycled.pop_back();
+        }
+
+        bind(fields, row);
+        row.offset = reader->rowOffset();
+
+        // One clock read per row: binding time runs from the previous row
+        long long now = nowNanos();
+        batchPending.push_back({row.offset, static_cast<uint64_t>(now - lastAt), now, 0, false});
+        batch.push_back(std::move(row));
+        lastAt = now;
+
+        if (batch.size() >= kParseBatch) {
+            publish(batch, batchPending);
+            lastAt = nowNanos();
+        }
+    }
+
+    if (!batch.empty()) {
+        publish(batch, batchPending);
+    }
+
+    std::lock_guard<std::mutex> lock(queueMutex);
+    stats.parseDone = true;
+    stats.readFailed = reader->failed();
+    stats.bytesRead = reader->bytesConsumed();
+}
+
+void BatchEngine::publish(std::vector<BoundRow>& batch, std::vector<Pending>& batchPending) {
+    {
+        std::unique_lock<std::mutex> lock(queueMutex);
+        // Completed rows stay in `pending` until every earlier row is done
+        queueSpace.wait(lock, [this, &batch] {
+            return stopRequested ||
+                   (queue.size() < queueCapacity && pending.size() + batch.size() <= pendingWindow());
+        });
+        if (stopRequested) {
+            return;
+        }
+
+        for (size_t i = 0; i < batch.size(); i++) {
+            batch[i].row = nextRow++;
+            pending.push_back(batchPending[i]);
+            stats.bindNanos += batchPending[i].bindNanos;
+            queue.push_back(std::move(batch[i]));
+        }
+
+        // The batch ends at the last row read, so the reader sits on the next one
+        nextOffset = reader->bytesConsumed();
+        stats.rowsParsed += batch.size();
+        stats.rowsQueued += batch.size();
+        stats.bytesRead = nextOffset;
+    }
+    batch.clear();
+    batchPending.clear();
+}
+
+size_t BatchEngine::pendingWindow() const {
+    return std::max(queueCapacity * 4, queueCapacity + kParseBatch);
+}
+
+size_t BatchEngine::next(std::vector<BoundRow>& rows, size_t maxRows) {
+    size_t taken = 0;
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        for (BoundRow& row : rows) {
+            if (spare.size() >= queueCapacity + kParseBatch) {
+                break;
+            }
+            spare.push_back(std::move(row));
+        }
+        rows.clear();
+
+        long long now = nowNanos();
+        while (taken < maxRows && !queue.empty()) {
+            BoundRow& row = queue.front();
+            pending[row.row - pendingBase].dequeuedAt = now;
+            rows.push_back(std::move(row));
+            queue.pop_front();
+            taken++;
+        }
+    }
+    if (taken > 0) {
+        queueSpace.notify_one();
+    }
+    return taken;
+}
+
+bool BatchEngine::complete(uint64_t row, bool ok) {
+    std::unique_lock<std::mutex> lock(queueMutex);
+
+    if (row < pendingBase || row - pendingBase >= pending.size()) {
+        return false;
+    }
+    Pending& entry = pending[row - pendingBase];
+    if (entry.dequeuedAt == 0 || entry.done) {
+        return false;
+    }
+
+    long long now = nowNanos();
+    RowTiming timing;
+    timing.row = row;
+    timing.bindNanos = entry.bindNanos;
+    timing.queueNanos = static_cast<uint64_t>(entry.dequeuedAt - entry.queuedAt);
+    timing.runNanos = static_cast<uint64_t>(now - entry.dequeuedAt);
+    timing.ok = ok;
+    entry.done = true;
+
+    // Rows may complete out of order; the checkpoint only advances past a
+    // contiguous prefix of completed rows
+    uint64_t base = pendingBase;
+    while (!pending.empty() && pending.front().done) {
+        pending.pop_front();
+        pendingBase++;
+    }
+
+    stats.rowsCompleted++;
+    if (!ok) {
+        stats.rowsFailed++;
+    }
+    stats.runNanos += timing.runNanos;
+
+    if (timings.size() >= kMaxRetainedTimings) {
+        timings.pop_front();
+    }
+    timings.push_back(timing);
+
+    // The parse thread may be waiting for the window to move
+    if (pendingBase != base) {
+        lock.unlock();
+        queueSpace.notify_one();
+    }
+    return true;
+}
+
+bool BatchEngine::finished() const {
+    std::lock_guard<std::mutex> lock(queueMutex);
+    return stats.parseDone && pending.empty();
+}
+
+BatchProgress BatchEngine::progress() const {
+    std::lock_guard<std::mutex> lock(queueMutex);
+    return stats;
+}
+
+BatchCheckpoint BatchEngine::checkpoint() const {
+    std::lock_guard<std::mutex> lock(queueMutex);
+
+    BatchCheckpoint result;
+    if (!pending.empty()) {
+        result.row = pendingBase;
+        result.offset = pending.front().offset;
+    } else {
+        result.row = nextRow;
+        result.offset = nextOffset;
+    }
+    return result;
+}
+
+size_t BatchEngine::takeTimings(std::vector<RowTiming>& out) {
+    std::lock_guard<std::mutex> lock(queueMutex);
+    out.assign(timings.begin(), timings.end());
+    timings.clear();
+    return out.size();
+}
@@ -0,0 +1,166 @@
+#pragma once
+
+// Runs one flow over every row of a CSV/TSV table variable. A parse thread
+// streams rows out of the file, binds them into the flow's compiled
+// templates and feeds a bounded replay queue; the caller pulls bound rows,
+// replays them and reports completion. Progress, a resumable checkpoint and
+// per-row timing are tracked along the way.
+
+#include "csv_reader.h"
+#include "flow_template.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Templated FlowStep fields. Absent fields are left to the caller.
+enum BatchField : uint8_t { kBatchSelector, kBatchText, kBatchUrl };
+
+struct BatchStepTemplate {
+    bool hasSelector = false;
+    bool hasText = false;
+    bool hasUrl = false;
+    std::string selector;
+    std::string text;
+    std::string url;
+};
+
+struct BatchConfig {
+    std::string path;
+    char delimiter = 0; // 0 = by extension
+    std::string tableVariable;
+    std::vector<std::pair<std::string, std::string>> variables;
+    std::vector<BatchStepTemplate> steps;
+
+    // Resume point from a previous checkpoint. With an offset the reader
+    // seeks straight to the row; without one it skips startRow rows.
+    uint64_t startRow = 0;
+    uint64_t startOffset = 0;
+    // Bound rows waiting for the caller. Parsing also pauses while more than
+    // four times this many rows are queued or in flight past the oldest
+    // uncompleted one, so a row that never completes cannot grow memory.
+    size_t queueCapacity = 256;
+};
+
+// One (step, field) pair rendered for every row
+struct BatchSlot {
+    uint32_t step;
+    BatchField field;
+};
+
+struct BoundRow {
+    uint64_t row = 0;
+    uint64_t offset = 0;
+    // Rendered values for each BatchSlot, back to back
+    std::string values;
+    std::vector<uint32_t> ends;
+
+    std::string_view value(size_t slot) const {
+        uint32_t begin = slot == 0 ? 0 : ends[slot - 1];
+        return std::string_view(values.data() + begin, ends[slot] - begin);
+    }
+};
+
+// Rows bind in well under a microsecond, so timings are kept in nanoseconds
+struct RowTiming {
+    uint64_t row;
+    uint64_t bindNanos;  // Parse and template binding
+    uint64_t queueNanos; // Bound until handed to the caller
+    uint64_t runNanos;   // Handed out until completed
+    bool ok;
+};
+
+struct BatchProgress {
+    uint64_t rowsParsed = 0;
+    uint64_t rowsQueued = 0;
+    uint64_t rowsCompleted = 0;
+    uint64_t rowsFailed = 0;
+    uint64_t bytesRead = 0;
+    uint64_t totalBytes = 0;
+    uint64_t bindNanos = 0;
+    uint64_t runNanos = 0;
+    bool parseDone = false;
+    bool readFailed = false;
+};
+
+// Every row before `row` has completed; `offset` is where that row starts
+struct BatchCheckpoint {
+    uint64_t row = 0;
+    uint64_t offset = 0;
+};
+
+class BatchEngine {
+public:
+    BatchEngine();
+    ~BatchEngine();
+
+    // Opens the table, compiles the templates against its header and starts
+    // the parse thread. Returns false with a message on any failure.
+    bool start(const BatchConfig& config, std::string& error);
+    void cancel();
+
+    // Non-blocking. Rows already in `rows` are recycled, then up to maxRows
+    // ready rows are moved in; returns how many.
+    size_t next(std::vector<BoundRow>& rows, size_t maxRows);
+    bool complete(uint64_t row, bool ok);
+
+    // Parsing has ended and every queued row has been completed
+    bool finished() const;
+
+    BatchProgress progress() const;
+    BatchCheckpoint checkpoint() const;
+    size_t takeTimings(std::vector<RowTiming>& out);
+
+    const std::vector<BatchSlot>& slots() const { return slotList; }
+    const std::vector<std::string>& columns() const { return header; }
+
+    static constexpr size_t kMaxRetainedTimings = 65536;
+
+private:
+    struct Pending {
+        uint64_t offset;
+        uint64_t bindNanos;
+        long long queuedAt;
+        long long dequeuedAt;
+        bool done;
+    };
+
+    static constexpr size_t kParseBatch = 64;
+
+    void run();
+    void bind(const std::vector<std::string_view>& fields, BoundRow& row);
+    void publish(std::vector<BoundRow>& batch, std::vector<Pending>& batchPending);
+    size_t pendingWindow() const;
+    static long long nowNanos();
+
+    std::unique_ptr<CsvReader> reader;
+    std::vector<std::string> header;
+    std::vector<FlowTemplate> templates;
+    std::vector<BatchSlot> slotList;
+    size_t queueCapacity;
+    uint64_t skipRows;
+
+    std::thread parser;
+    std::atomic<bool> stopRequested;
+
+    mutable std::mutex queueMutex;
+    std::condition_variable queueSpace;
+    std::deque<BoundRow> queue;
+    // Bound rows handed back by the caller, reused to avoid allocating per row
+    std::vector<BoundRow> spare;
+    // Queued and in-flight rows; pending[0] is row pendingBase and bounds the
+    // checkpoint. Held to pendingWindow() rows.
+    std::deque<Pending> pending;
+    uint64_t pendingBase;
+    std::deque<RowTiming> timings;
+    uint64_t nextRow;
+    uint64_t nextOffset;
+    BatchProgress stats;
+};
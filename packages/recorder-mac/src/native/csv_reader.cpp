@@ -0,0 +1,375 @@
+#include "csv_reader.h"
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+namespace {
+
+// SIMD loads may run this far past the last valid byte
+const size_t kBlockSize = 64;
+
+bool hasSuffix(const std::string& value, const char* suffix) {
+    size_t length = strlen(suffix);
+    if (value.size() < length) {
+        return false;
+    }
+    for (size_t i = 0; i < length; i++) {
+        char c = value[value.size() - length + i];
+        if (c >= 'A' && c <= 'Z') {
+            c = static_cast<char>(c - 'A' + 'a');
+        }
+        if (c != suffix[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+#if defined(__SSE2__)
+inline uint64_t matchBlock16(const char* p, __m128i delim, __m128i quote, __m128i lf, __m128i cr) {
+    __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+    __m128i hits = _mm_or_si128(
+        _mm_or_si128(_mm_cmpeq_epi8(bytes, delim), _mm_cmpeq_epi8(bytes, quote)),
+        _mm_or_si128(_mm_cmpeq_epi8(bytes, lf), _mm_cmpeq_epi8(bytes, cr)));
+    return static_cast<uint32_t>(_mm_movemask_epi8(hits));
+}
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+inline uint64_t matchBlock16(const char* p, uint8x16_t delim, uint8x16_t quote, uint8x16_t lf, uint8x16_t cr) {
+    static const uint8_t kBits[16] = {1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128};
+    uint8x16_t bytes = vld1q_u8(reinterpret_cast<const uint8_t*>(p));
+    uint8x16_t hits = vorrq_u8(
+        vorrq_u8(vceqq_u8(bytes, delim), vceqq_u8(bytes, quote)),
+        vorrq_u8(vceqq_u8(bytes, lf), vceqq_u8(bytes, cr)));
+    uint8x16_t bits = vandq_u8(hits, vld1q_u8(kBits));
+    return static_cast<uint64_t>(vaddv_u8(vget_low_u8(bits))) |
+           (static_cast<uint64_t>(vaddv_u8(vget_high_u8(bits))) << 8);
+}
+#endif
+
+inline int lowestBit(uint64_t value) {
+    return __builtin_ctzll(value);
+}
+
+}
+
+std::unique_ptr<CsvReader> CsvReader::open(const std::string& path, char delimiter, size_t chunkSize) {
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return nullptr;
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || !S_ISREG(info.st_mode)) {
+        close(fd);
+        return nullptr;
+    }
+
+#ifdef POSIX_FADV_SEQUENTIAL
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+
+    if (delimiter == 0) {
+        delimiter = hasSuffix(path, ".tsv") || hasSuffix(path, ".tab") ? '\t' : ',';
+    }
+
+    return std::unique_ptr<CsvReader>(
+        new CsvReader(fd, delimiter, static_cast<uint64_t>(info.st_size), chunkSize));
+}
+
+CsvReader::CsvReader(int fd, char delimiter, uint64_t size, size_t chunkSize)
+  : fd(fd),
+    delim(delimiter),
+    size(size),
+    chunkSize(chunkSize < kBlockSize ? kBlockSize : chunkSize),
+    pos(0),
+    end(0),
+    fileOffset(0),
+    eof(false),
+    readError(false),
+    lastRowOffset(0),
+    positionCursor(0),
+    positionCount(0) {
+    buffer.resize(this->chunkSize + kBlockSize);
+}
+
+CsvReader::~CsvReader() {
+    close(fd);
+}
+
+bool CsvReader::seek(uint64_t offset) {
+    if (lseek(fd, static_cast<off_t>(offset), SEEK_SET) < 0) {
+        return false;
+    }
+    fileOffset = offset;
+    pos = 0;
+    end = 0;
+    eof = false;
+    readError = false;
+    positionCount = 0;
+    positionCursor = 0;
+    return true;
+}
+
+bool CsvReader::refill() {
+    if (eof) {
+        return false;
+    }
+
+    // Keep the partial row and slide it to the front
+    if (pos > 0) {
+        memmove(buffer.data(), buffer.data() + pos, end - pos);
+        fileOffset += pos;
+        end -= pos;
+        pos = 0;
+    }
+
+    size_t capacity = buffer.size() - kBlockSize;
+    if (end == capacity) {
+        // A single row is larger than the buffer
+        buffer.resize(capacity * 2 + kBlockSize);
+        capacity *= 2;
+    }
+
+    ssize_t received;
+    do {
+        received = read(fd, buffer.data() + end, capacity - end);
+    } while (received < 0 && errno == EINTR);
+
+    if (received < 0) {
+        readError = true;
+        eof = true;
+        return false;
+    }
+    if (received == 0) {
+        // Rescan the partial row now that its end is known
+        eof = true;
+        indexStructurals();
+        return true;
+    }
+
+    bool atStart = fileOffset == 0 && end == 0;
+    end += static_cast<size_t>(received);
+
+    // Skip a UTF-8 byte order mark
+    if (atStart && end >= 3 && memcmp(buffer.data(), "\xEF\xBB\xBF", 3) == 0) {
+        pos = 3;
+    }
+    indexStructurals();
+    return true;
+}
+
+uint64_t CsvReader::blockMask(size_t base) const {
+    const char* p = buffer.data() + base;
+    uint64_t result = 0;
+
+#if defined(__SSE2__)
+    __m128i d = _mm_set1_epi8(delim);
+    __m128i q = _mm_set1_epi8('"');
+    __m128i lf = _mm_set1_epi8('\n');
+    __m128i cr = _mm_set1_epi8('\r');
+    for (size_t i = 0; i < kBlockSize; i += 16) {
+        result |= matchBlock16(p + i, d, q, lf, cr) << i;
+    }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    uint8x16_t d = vdupq_n_u8(static_cast<uint8_t>(delim));
+    uint8x16_t q = vdupq_n_u8('"');
+    uint8x16_t lf = vdupq_n_u8('\n');
+    uint8x16_t cr = vdupq_n_u8('\r');
+    for (size_t i = 0; i < kBlockSize; i += 16) {
+        result |= matchBlock16(p + i, d, q, lf, cr) << i;
+    }
+#else
+    for (size_t i = 0; i < kBlockSize; i++) {
+        char c = p[i];
+        if (c == delim || c == '"' || c == '\n' || c == '\r') {
+            result |= 1ull << i;
+        }
+    }
+#endif
+
+    // Bytes past the end of valid input are stale
+    size_t valid = end - base;
+    if (valid < kBlockSize) {
+        result &= (1ull << valid) - 1;
+    }
+    return result;
+}
+
+void CsvReader::indexStructurals() {
+    // Flatten the per-block bitmaps into a list of offsets once per refill,
+    // so row scanning is a walk over a short array
+    positions.resize(end - pos + kBlockSize);
+    uint32_t* out = positions.data();
+    size_t count = 0;
+
+    for (size_t base = pos & ~(kBlockSize - 1); base < end; base += kBlockSize) {
+        uint64_t bits = blockMask(base);
+        if (base < pos) {
+            bits &= ~0ull << (pos - base);
+        }
+        while (bits != 0) {
+            out[count++] = static_cast<uint32_t>(base + lowestBit(bits));
+            bits &= bits - 1;
+        }
+    }
+
+    positionCount = count;
+    positionCursor = 0;
+}
+
+int CsvReader::scanRow(size_t& rowEnd) {
+    const char* data = buffer.data();
+    spans.clear();
+    size_t p = pos;
+
+    while (true) {
+        if (p >= end) {
+            if (!eof) {
+                return 0;
+            }
+            // Trailing delimiter at end of file
+            spans.push_back({p, 0, false});
+            rowEnd = end;
+            return 1;
+        }
+
+        if (data[p] == '"') {
+            size_t q = p + 1;
+            bool escaped = false;
+            while (true) {
+                q = nextStructural(q);
+                if (q >= end) {
+                    if (!eof) {
+                        return 0;
+                    }
+                    // Unterminated quote: take the rest of the file
+                    spans.push_back({p + 1, end - p - 1, escaped});
+                    rowEnd = end;
+                    return 1;
+                }
+                if (data[q] != '"') {
+                    q++;
+                    continue;
+                }
+                if (q + 1 >= end && !eof) {
+                    return 0;
+                }
+                if (q + 1 < end && data[q + 1] == '"') {
+                    escaped = true;
+                    q += 2;
+                    continue;
+                }
+                break;
+            }
+            spans.push_back({p + 1, q - p - 1, escaped});
+
+            // Anything between the closing quote and the delimiter is dropped
+            p = q + 1;
+            while (true) {
+                p = nextStructural(p);
+                if (p < end && data[p] == '"') {
+                    p++;
+                    continue;
+                }
+                break;
+            }
+        } else {
+            // Quotes inside an unquoted field are literal
+            size_t q = p;
+            while (true) {
+                q = nextStructural(q);
+                if (q < end && data[q] == '"') {
+                    q++;
+                    continue;
+                }
+                break;
+            }
+            spans.push_back({p, q - p, false});
+            p = q;
+        }
+
+        if (p >= end) {
+            if (!eof) {
+                return 0;
+            }
+            rowEnd = end;
+            return 1;
+        }
+
+        char c = data[p];
+        if (c == delim) {
+            p++;
+            continue;
+        }
+        if (c == '\n') {
+            rowEnd = p + 1;
+            return 1;
+        }
+        // '\r', optionally followed by '\n'
+        if (p + 1 >= end) {
+            if (!eof) {
+                return 0;
+            }
+            rowEnd = end;
+            return 1;
+        }
+        rowEnd = p + 1 + (data[p + 1] == '\n' ? 1 : 0);
+        return 1;
+    }
+}
+
+bool CsvReader::readRow(std::vector<std::string_view>& fields) {
+    while (true) {
+        if (pos >= end) {
+            if (!refill() || pos >= end) {
+                if (eof) {
+                    return false;
+                }
+                continue;
+            }
+        }
+
+        size_t rowEnd = 0;
+        if (scanRow(rowEnd) == 0) {
+            if (!refill() && readError) {
+                return false;
+            }
+            continue;
+        }
+
+        size_t rowStart = pos;
+        pos = rowEnd;
+
+        if (spans.size() == 1 && spans[0].length == 0 && buffer[rowStart] != '"') {
+            continue;
+        }
+
+        // Collapse doubled quotes in place; the result is never longer
+        char* data = buffer.data();
+        fields.clear();
+        for (FieldSpan& span : spans) {
+            if (span.escaped) {
+                size_t out = span.start;
+                size_t last = span.start + span.length;
+                for (size_t in = span.start; in < last; in++) {
+                    data[out++] = data[in];
+                    if (data[in] == '"' && in + 1 < last && data[in + 1] == '"') {
+                        in++;
+                    }
+                }
+                span.length = out - span.start;
+            }
+            fields.emplace_back(data + span.start, span.length);
+        }
+
+        lastRowOffset = fileOffset + rowStart;
+        return true;
+    }
+}
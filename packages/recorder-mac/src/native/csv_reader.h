@@ -0,0 +1,81 @@
+#pragma once
+
+// Streaming CSV/TSV reader for table variables. The file is read in fixed
+// chunks and never held whole; structural characters are located 64 bytes
+// at a time with SSE2/NEON compares. Fields follow RFC 4180 quoting.
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+class CsvReader {
+public:
+    // delimiter 0 picks '\t' for .tsv/.tab files and ',' otherwise
+    static std::unique_ptr<CsvReader> open(const std::string& path, char delimiter = 0,
+                                           size_t chunkSize = 1 << 20);
+    ~CsvReader();
+
+    // Fills `fields` with views into the reader's buffer, valid until the
+    // next call. Blank lines are skipped. Returns false at end of file or on
+    // a read error (see failed()).
+    bool readRow(std::vector<std::string_view>& fields);
+
+    // Byte offset of the row most recently returned by readRow
+    uint64_t rowOffset() const { return lastRowOffset; }
+
+    // Repositions at a row boundary previously reported by rowOffset()
+    bool seek(uint64_t offset);
+
+    char delimiter() const { return delim; }
+    uint64_t bytesConsumed() const { return fileOffset + static_cast<uint64_t>(pos); }
+    uint64_t fileSize() const { return size; }
+    bool failed() const { return readError; }
+
+private:
+    struct FieldSpan {
+        size_t start;
+        size_t length;
+        bool escaped;
+    };
+
+    CsvReader(int fd, char delimiter, uint64_t size, size_t chunkSize);
+
+    // Locates the next delimiter, quote, CR or LF at or after `from`;
+    // calls within a row must not go backwards
+    size_t nextStructural(size_t from) {
+        while (positionCursor < positionCount && positions[positionCursor] < from) {
+            positionCursor++;
+        }
+        return positionCursor < positionCount ? positions[positionCursor] : end;
+    }
+    uint64_t blockMask(size_t base) const;
+    void indexStructurals();
+
+    // Returns 1 for a complete row, 0 if more input is needed, -1 on error
+    int scanRow(size_t& rowEnd);
+    bool refill();
+
+    int fd;
+    char delim;
+    uint64_t size;
+    size_t chunkSize;
+
+    // Unparsed input lives in buffer[pos, end); buffer[0] maps to fileOffset
+    std::vector<char> buffer;
+    size_t pos;
+    size_t end;
+    uint64_t fileOffset;
+    bool eof;
+    bool readError;
+    uint64_t lastRowOffset;
+
+    // Buffer offsets of every structural character in [pos, end)
+    std::vector<uint32_t> positions;
+    size_t positionCursor;
+    size_t positionCount;
+
+    std::vector<FieldSpan> spans;
+};
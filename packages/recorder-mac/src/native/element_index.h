@@ -0,0 +1,385 @@
+#pragma once
+
+// Per-window spatial index of known element frames, used to answer
+// point-to-element queries without an AX round trip into the target app.
+// Deliberately free of CoreGraphics/AX types so it builds on any platform.
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+struct IndexRect {
+    int x;
+    int y;
+    int width;
+    int height;
+
+    bool contains(int px, int py) const {
+        return px >= x && py >= y && px < x + width && py < y + height;
+    }
+    long long area() const { return static_cast<long long>(width) * height; }
+};
+
+struct ElementIndexStats {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t staleMisses = 0;
+    uint64_t inserts = 0;
+    uint64_t windowMoves = 0;
+    uint64_t windowResets = 0;
+    uint64_t evictions = 0;
+    size_t elements = 0;
+    size_t windows = 0;
+};
+
+template <typename Payload>
+class ElementIndex {
+public:
+    using WindowId = uint64_t;
+
+    struct Hit {
+        const Payload* payload;
+        IndexRect frame; // Screen coordinates, adjusted for window moves
+    };
+
+    ElementIndex(long long ttlMicros = 5000 * 1000,
+                 size_t maxElementsPerWindow = 512,
+                 size_t maxWindows = 16,
+                 int cellSize = 64)
+        : ttlMicros(ttlMicros),
+          maxElementsPerWindow(maxElementsPerWindow),
+          maxWindows(maxWindows),
+          cellSize(cellSize) {}
+
+    // Records an element frame (screen coordinates) inside a window. The
+    // window is created, moved or reset as needed and becomes the topmost.
+    void insert(WindowId id, int owner, const IndexRect& windowFrame,
+                const IndexRect& elementFrame, const Payload& payload, long long now) {
+        Window& window = touchWindow(id, owner, windowFrame, now);
+
+        IndexRect rect = {
+            elementFrame.x - window.frame.x,
+            elementFrame.y - window.frame.y,
+            elementFrame.width,
+            elementFrame.height
+        };
+        if (rect.width <= 0 || rect.height <= 0 || !overlapsWindow(window, rect)) {
+            return;
+        }
+
+        // Same frame means same element for our purposes; refresh in place.
+        // Any entry with this frame is registered in the cell of its origin.
+        for (uint32_t index : window.cells[cellIndex(window, rect.x, rect.y)]) {
+            Entry& entry = window.entries[index];
+            if (sameRect(entry.rect, rect)) {
+                entry.payload = payload;
+                entry.insertedAt = now;
+                stats.inserts++;
+                return;
+            }
+        }
+
+        if (window.entries.size() >= maxElementsPerWindow) {
+            compact(window, now);
+        }
+
+        window.entries.push_back({rect, payload, now});
+        addToCells(window, static_cast<uint32_t>(window.entries.size() - 1));
+        stats.inserts++;
+    }
+
+    // A moved window keeps its entries (they are stored window-relative);
+    // a resized window may have reflowed, so its entries are dropped.
+    void updateWindow(WindowId id, const IndexRect& frame) {
+        Window* window = findWindow(id);
+        if (!window) {
+            return;
+        }
+
+        if (frame.width == window->frame.width && frame.height == window->frame.height) {
+            if (frame.x != window->frame.x || frame.y != window->frame.y) {
+                window->frame = frame;
+                stats.windowMoves++;
+            }
+            return;
+        }
+
+        resetWindow(*window, frame);
+        stats.windowResets++;
+    }
+
+    void raiseWindow(WindowId id, long long now) {
+        auto it = std::find_if(windows.begin(), windows.end(),
+            [id](const Window& w) { return w.id == id; });
+        if (it == windows.end()) {
+            return;
+        }
+        it->touchedAt = now;
+        std::rotate(windows.begin(), it, it + 1);
+    }
+
+    void removeWindow(WindowId id) {
+        windows.erase(
+            std::remove_if(windows.begin(), windows.end(),
+                [id](const Window& w) { return w.id == id; }),
+            windows.end());
+    }
+
+    // Drops every window of one owner, e.g. after its layout changed
+    void removeOwner(int owner) {
+        windows.erase(
+            std::remove_if(windows.begin(), windows.end(),
+                [owner](const Window& w) { return w.owner == owner; }),
+            windows.end());
+    }
+
+    // Drops the entries of one window, e.g. after its layout changed; the
+    // window itself stays known
+    bool clearWindow(WindowId id) {
+        Window* window = findWindow(id);
+        if (!window) {
+            return false;
+        }
+        if (!window->entries.empty()) {
+            resetWindow(*window, window->frame);
+            stats.windowResets++;
+        }
+        return true;
+    }
+
+    // Drops the entries of one owner whose payload passes `match`, e.g. an
+    // element whose value changed or that was not at the point it was hit at
+    template <typename Match>
+    size_t removeEntries(int owner, Match match) {
+        size_t removed = 0;
+        for (Window& window : windows) {
+            if (window.owner != owner) {
+                continue;
+            }
+            size_t before = window.entries.size();
+            window.entries.erase(
+                std::remove_if(window.entries.begin(), window.entries.end(),
+                    [&match](const Entry& entry) { return match(entry.payload); }),
+                window.entries.end());
+            if (window.entries.size() != before) {
+                removed += before - window.entries.size();
+                rebuildCells(window);
+            }
+        }
+        stats.evictions += removed;
+        return removed;
+    }
+
+    // Drops the entries of the topmost window under the point, whose content
+    // may have scrolled; the window itself stays known
+    bool resetWindowAt(int x, int y) {
+        for (Window& window : windows) {
+            if (window.frame.contains(x, y)) {
+                if (!window.entries.empty()) {
+                    resetWindow(window, window.frame);
+                    stats.windowResets++;
+                }
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Looks only at the topmost known window under the point; windows behind
+    // it are occluded. `owner` restricts the search to one owner (0 = any).
+    bool hitTest(int x, int y, int owner, long long now, Hit& hit) {
+        return hitTest(x, y, owner, now, [](const Payload&) { return true; }, hit);
+    }
+
+    // As above, but only entries whose payload passes `accept` can match, so
+    // the caller can require the entry to be the element actually at the point
+    template <typename Accept>
+    bool hitTest(int x, int y, int owner, long long now, Accept accept, Hit& hit) {
+        for (const Window& window : windows) {
+            if ((owner != 0 && window.owner != owner) || !window.frame.contains(x, y)) {
+                continue;
+            }
+
+            int rx = x - window.frame.x;
+            int ry = y - window.frame.y;
+            const std::vector<uint32_t>& cell = window.cells[cellIndex(window, rx, ry)];
+
+            const Entry* best = nullptr;
+            bool sawStale = false;
+            for (uint32_t index : cell) {
+                const Entry& entry = window.entries[index];
+                if (!entry.rect.contains(rx, ry)) {
+                    continue;
+                }
+                if (now - entry.insertedAt > ttlMicros || !accept(entry.payload)) {
+                    sawStale = true;
+                    continue;
+                }
+                // Prefer the innermost element when frames nest, then the newest
+                if (!best || entry.rect.area() < best->rect.area() ||
+                    (entry.rect.area() == best->rect.area() && entry.insertedAt > best->insertedAt)) {
+                    best = &entry;
+                }
+            }
+
+            if (!best) {
+                stats.misses++;
+                if (sawStale) {
+                    stats.staleMisses++;
+                }
+                return false;
+            }
+
+            hit.payload = &best->payload;
+            hit.frame = {
+                best->rect.x + window.frame.x,
+                best->rect.y + window.frame.y,
+                best->rect.width,
+                best->rect.height
+            };
+            stats.hits++;
+            return true;
+        }
+
+        stats.misses++;
+        return false;
+    }
+
+    void clear() {
+        windows.clear();
+    }
+
+    ElementIndexStats getStats() const {
+        ElementIndexStats result = stats;
+        result.windows = windows.size();
+        result.elements = 0;
+        for (const Window& window : windows) {
+            result.elements += window.entries.size();
+        }
+        return result;
+    }
+
+private:
+    struct Entry {
+        IndexRect rect; // Relative to the window origin
+        Payload payload;
+        long long insertedAt;
+    };
+
+    struct Window {
+        WindowId id;
+        int owner;
+        IndexRect frame;
+        long long touchedAt;
+        int columns;
+        int rows;
+        std::vector<Entry> entries;
+        std::vector<std::vector<uint32_t>> cells;
+    };
+
+    Window* findWindow(WindowId id) {
+        for (Window& window : windows) {
+            if (window.id == id) {
+                return &window;
+            }
+        }
+        return nullptr;
+    }
+
+    Window& touchWindow(WindowId id, int owner, const IndexRect& frame, long long now) {
+        if (findWindow(id)) {
+            updateWindow(id, frame);
+            raiseWindow(id, now);
+            windows.front().owner = owner;
+            return windows.front();
+        }
+
+        if (windows.size() >= maxWindows) {
+            windows.pop_back();
+        }
+
+        Window window;
+        window.id = id;
+        window.owner = owner;
+        window.touchedAt = now;
+        resetWindow(window, frame);
+        windows.insert(windows.begin(), std::move(window));
+        return windows.front();
+    }
+
+    void resetWindow(Window& window, const IndexRect& frame) {
+        window.frame = frame;
+        window.columns = std::max(1, (frame.width + cellSize - 1) / cellSize);
+        window.rows = std::max(1, (frame.height + cellSize - 1) / cellSize);
+        window.entries.clear();
+        window.cells.assign(static_cast<size_t>(window.columns) * window.rows, std::vector<uint32_t>());
+    }
+
+    size_t cellIndex(const Window& window, int rx, int ry) const {
+        int column = std::min(std::max(rx / cellSize, 0), window.columns - 1);
+        int row = std::min(std::max(ry / cellSize, 0), window.rows - 1);
+        return static_cast<size_t>(row) * window.columns + column;
+    }
+
+    bool overlapsWindow(const Window& window, const IndexRect& rect) const {
+        return rect.x < window.frame.width && rect.y < window.frame.height &&
+               rect.x + rect.width > 0 && rect.y + rect.height > 0;
+    }
+
+    void addToCells(Window& window, uint32_t index) {
+        const IndexRect& rect = window.entries[index].rect;
+        int firstColumn = std::max(rect.x / cellSize, 0);
+        int firstRow = std::max(rect.y / cellSize, 0);
+        int lastColumn = std::min((rect.x + rect.width - 1) / cellSize, window.columns - 1);
+        int lastRow = std::min((rect.y + rect.height - 1) / cellSize, window.rows - 1);
+
+        for (int row = firstRow; row <= lastRow; row++) {
+            for (int column = firstColumn; column <= lastColumn; column++) {
+                window.cells[static_cast<size_t>(row) * window.columns + column].push_back(index);
+            }
+        }
+    }
+
+    // Drops expired entries, then the oldest half if still full, and rebuilds the grid
+    void compact(Window& window, long long now) {
+        std::vector<Entry> kept;
+        kept.reserve(window.entries.size());
+        for (Entry& entry : window.entries) {
+            if (now - entry.insertedAt <= ttlMicros) {
+                kept.push_back(std::move(entry));
+            }
+        }
+
+        if (kept.size() >= maxElementsPerWindow) {
+            std::sort(kept.begin(), kept.end(),
+                [](const Entry& a, const Entry& b) { return a.insertedAt > b.insertedAt; });
+            kept.resize(maxElementsPerWindow / 2);
+        }
+
+        window.entries.swap(kept);
+        rebuildCells(window);
+    }
+
+    void rebuildCells(Window& window) {
+        for (std::vector<uint32_t>& cell : window.cells) {
+            cell.clear();
+        }
+        for (uint32_t i = 0; i < window.entries.size(); i++) {
+            addToCells(window, i);
+        }
+    }
+
+    static bool sameRect(const IndexRect& a, const IndexRect& b) {
+        return a.x == b.x && a.y == b.y && a.width == b.width && a.height == b.height;
+    }
+
+    long long ttlMicros;
+    size_t maxElementsPerWindow;
+    size_t maxWindows;
+    int cellSize;
+
+    // Ordered front to back by most recent activity
+    std::vector<Window> windows;
+    ElementIndexStats stats;
+};
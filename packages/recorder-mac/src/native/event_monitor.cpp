@@ -1,21 +1,54 @@
 #include "event_monitor.h"
 #include "ax_element.h"
+#include "hover_prefetcher.h"
+#include "window_observer.h"
 #include <CoreGraphics/CoreGraphics.h>
 #include <ApplicationServices/ApplicationServices.h>
 #include <iostream>
 
+#include <pthread.h>
+#include <algorithm>
+
 EventMonitor* EventMonitor::instance = nullptr;
 
+static long long steadyMicros() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()
+    ).count();
+}
+
 EventMonitor::EventMonitor() : 
     isRecording(false), 
     mouseEventTap(nullptr),
     keyEventTap(nullptr),
     runLoop(nullptr),
     mouseRunLoopSource(nullptr),
-    keyRunLoopSource(nullptr) {}
+    keyRunLoopSource(nullptr),
+    tapThreadState(TapThreadState::Stopped),
+    tapStopRequested(false),
+    timeoutRecoveries(0),
+    userInputRecoveries(0),
+    lastRecoveryAt(0),
+    prefetcher(new HoverPrefetcher()),
+    windowObserver(new WindowObserver([this](pid_t pid, uint64_t windowId, WindowChange change,
+                                             const Frame& frame, AXUIElementRef element) {
+        onWindowChanged(pid, windowId, change, frame, element);
+    })),
+    indexStopRequested(true),
+    subscriberList(new SubscriberList()),
+    nextSubscriptionId(1) {
+    for (size_t i = 0; i < kHazardSlots; i++) {
+        hazardClaimed[i].store(false, std::memory_order_relaxed);
+        hazards[i].store(nullptr, std::memory_order_relaxed);
+    }
+}
 
 EventMonitor::~EventMonitor() {
-    stopRecording();
+    stopTaps();
+    for (const SubscriberList* list : retiredLists) {
+        delete list;
+    }
+    delete subscriberList.load();
 }
 
 EventMonitor* EventMonitor::getInstance() {
@@ -25,25 +58,319 @@ EventMonitor* EventMonitor::getInstance() {
     return instance;
 }
 
-bool EventMonitor::startRecording(const std::string& sessionId) {
+bool EventMonitor::Subscriber::matchesPointer(uint32_t action, CGPoint location) const {
+    if (!active || (filter.actionMask & action) == 0) {
+        return false;
+    }
+    
+    if (filter.hasRegion) {
+        const Frame& r = filter.region;
+        if (location.x < r.x || location.y < r.y ||
+            location.x >= r.x + r.width || location.y >= r.y + r.height) {
+            return false;
+        }
+    }
+    
+    return true;
+}
+
+bool EventMonitor::Subscriber::matchesApp(const ApplicationInfo& appInfo) const {
+    if (filter.processId != 0 && filter.processId != appInfo.processId) {
+        return false;
+    }
+    return filter.appName.empty() || filter.appName == appInfo.name;
+}
+
+bool EventMonitor::Subscriber::matchesRole(const std::string& role) const {
+    return roleSet.empty() || roleSet.count(role) > 0;
+}
+
+void EventMonitor::DeliveryGate::close() {
+    // Pairs with deliver(): it counts itself in before reading `open`, so
+    // either it sees the gate closed or we see it in flight and wait.
+    open.store(false);
+    while (inFlight.load() != 0) {
+        std::this_thread::yield();
+    }
+}
+
+EventMonitor::SubscriberSnapshot::SubscriberSnapshot(const EventMonitor& monitor)
+  : monitor(monitor), slot(0), list(nullptr) {
+    for (;; slot = (slot + 1) % kHazardSlots) {
+        if (!monitor.hazardClaimed[slot].load(std::memory_order_relaxed) &&
+            !monitor.hazardClaimed[slot].exchange(true, std::memory_order_acquire)) {
+            break;
+        }
+    }
+    
+    // Re-check after naming the list so a writer that swapped it in between
+    // cannot have missed our hazard
+    const SubscriberList* loaded = monitor.subscriberList.load();
+    do {
+        list = loaded;
+        monitor.hazards[slot].store(list);
+        loaded = monitor.subscriberList.load();
+    } while (loaded != list);
+}
+
+EventMonitor::SubscriberSnapshot::~SubscriberSnapshot() {
+    monitor.hazards[slot].store(nullptr, std::memory_order_release);
+    monitor.hazardClaimed[slot].store(false, std::memory_order_release);
+}
+
+std::unique_ptr<EventMonitor::SubscriberList> EventMonitor::copySubscribers() const {
+    // Caller holds subscribersMutex, so the current list cannot be retired
+    std::unique_ptr<SubscriberList> list(new SubscriberList());
+    list->subscribers = subscriberList.load(std::memory_order_relaxed)->subscribers;
+    return list;
+}
+
+void EventMonitor::reclaimSubscriberLists() {
+    // Caller holds subscribersMutex. A retired list is freed once no hazard
+    // slot names it; readers that load it after the swap fail their re-check.
+    retiredLists.erase(
+        std::remove_if(retiredLists.begin(), retiredLists.end(),
+            [this](const SubscriberList* retired) {
+                for (size_t i = 0; i < kHazardSlots; i++) {
+                    if (hazards[i].load() == retired) {
+                        return false;
+                    }
+                }
+                delete retired;
+                return true;
+            }),
+        retiredLists.end());
+}
+
+void EventMonitor::publish(std::unique_ptr<SubscriberList> list) {
+    // Caller holds subscribersMutex
+    list->activeActionMask = 0;
+    list->activeCount = 0;
+    for (const auto& subscriber : list->subscribers) {
+        if (subscriber->active) {
+            list->activeActionMask |= subscriber->filter.actionMask;
+            list->activeCount++;
+        }
+    }
+    
+    retiredLists.push_back(subscriberList.exchange(list.release()));
+    reclaimSubscriberLists();
+}
+
+SubscriptionId EventMonitor::subscribe(const EventFilter& filter, StepCallback callback) {
+    std::lock_guard<std::mutex> lock(subscribersMutex);
+    
+    auto subscriber = std::make_shared<Subscriber>();
+    subscriber->id = nextSubscriptionId++;
+    subscriber->filter = filter;
+    subscriber->roleSet.insert(filter.roles.begin(), filter.roles.end());
+    subscriber->active = false;
+    subscriber->callback = std::move(callback);
+    subscriber->gate = std::make_shared<DeliveryGate>();
+    
+    std::unique_ptr<SubscriberList> list = copySubscribers();
+    list->subscribers.push_back(subscriber);
+    publish(std::move(list));
+    
+    return subscriber->id;
+}
+
+void EventMonitor::unsubscribe(SubscriptionId id) {
+    std::lock_guard<std::mutex> lock(subscribersMutex);
+    
+    std::unique_ptr<SubscriberList> list = copySubscribers();
+    auto& subscribers = list->subscribers;
+    for (const auto& subscriber : subscribers) {
+        if (subscriber->id == id) {
+            // Waits only for a callback already in progress, never for AX
+            subscriber->gate->close();
+        }
+    }
+    subscribers.erase(
+        std::remove_if(subscribers.begin(), subscribers.end(),
+            [id](const std::shared_ptr<const Subscriber>& s) { return s->id == id; }),
+        subscribers.end());
+    publish(std::move(list));
+    
+    if (subscriberList.load(std::memory_order_relaxed)->activeCount == 0) {
+        stopTaps();
+    }
+}
+
+bool EventMonitor::startRecording(SubscriptionId id, const std::string& sessionId) {
+    std::lock_guard<std::mutex> lock(subscribersMutex);
+    
+    std::unique_ptr<SubscriberList> list = copySubscribers();
+    for (auto& subscriber : list->subscribers) {
+        if (subscriber->id != id) {
+            continue;
+        }
+        if (subscriber->active) {
+            return false;
+        }
+        
+        // Taps are shared; only the first active subscriber creates them
+        if (!isRecording && !startTaps()) {
+            return false;
+        }
+        
+        // The gate is closed and drained here, so nothing reads sessionId
+        subscriber->gate->sessionId = sessionId;
+        subscriber->gate->open.store(true);
+        auto updated = std::make_shared<Subscriber>(*subscriber);
+        updated->active = true;
+        subscriber = updated;
+        publish(std::move(list));
+        return true;
+    }
+    
+    return false;
+}
+
+void EventMonitor::stopRecording(SubscriptionId id) {
+    std::lock_guard<std::mutex> lock(subscribersMutex);
+    
+    std::unique_ptr<SubscriberList> list = copySubscribers();
+    for (auto& subscriber : list->subscribers) {
+        if (subscriber->id == id && subscriber->active) {
+            subscriber->gate->close();
+            auto updated = std::make_shared<Subscriber>(*subscriber);
+            updated->active = false;
+            subscriber = updated;
+            publish(std::move(list));
+            break;
+        }
+    }
+    
+    if (subscriberList.load(std::memory_order_relaxed)->activeCount == 0) {
+        stopTaps();
+    }
+}
+
+bool EventMonitor::isRecordingActive(SubscriptionId id) const {
+    SubscriberSnapshot snapshot(*this);
+    for (const auto& subscriber : snapshot->subscribers) {
+        if (subscriber->id == id) {
+            return subscriber->active;
+        }
+    }
+    return false;
+}
+
+bool EventMonitor::startTaps() {
     if (isRecording) {
+        return true;
+    }
+    
+    tapStopRequested = false;
+    tapThreadState = TapThreadState::Starting;
+    tapThread = std::thread(&EventMonitor::runTapThread, this);
+    
+    // Wait for the tap thread to report whether the taps could be created
+    std::unique_lock<std::mutex> lock(tapThreadMutex);
+    tapThreadChanged.wait(lock, [this] { return tapThreadState != TapThreadState::Starting; });
+    bool running = tapThreadState == TapThreadState::Running;
+    lock.unlock();
+    
+    if (!running) {
+        tapThread.join();
         return false;
     }
     
-    this->sessionId = sessionId;
+    prefetcher->start();
+    {
+        std::lock_guard<std::mutex> indexLock(indexQueueMutex);
+        indexStopRequested = false;
+    }
+    indexThread = std::thread(&EventMonitor::runIndexThread, this);
+    isRecording = true;
+    return true;
+}
+
+void EventMonitor::stopTaps() {
+    if (!isRecording) {
+        return;
+    }
+    
+    isRecording = false;
+    tapStopRequested = true;
+    
+    {
+        std::lock_guard<std::mutex> lock(tapThreadMutex);
+        if (runLoop) {
+            CFRunLoopStop(runLoop);
+        }
+    }
+    
+    tapThread.join();
+    prefetcher->stop();
+    
+    // The tap thread is gone, so nothing queues new elements
+    {
+        std::lock_guard<std::mutex> lock(indexQueueMutex);
+        indexStopRequested = true;
+        indexQueue.clear();
+    }
+    indexQueueChanged.notify_all();
+    indexThread.join();
+    
+    std::lock_guard<std::mutex> lock(frameIndexMutex);
+    frameIndex.clear();
+}
+
+void EventMonitor::runTapThread() {
+    // Input delivery is latency sensitive; keep this thread ahead of background work
+    pthread_set_qos_class_self_np(QOS_CLASS_USER_INTERACTIVE, 0);
+    
+    bool created = createTaps();
+    if (created) {
+        windowObserver->attach(CFRunLoopGetCurrent());
+    }
+    
+    {
+        std::lock_guard<std::mutex> lock(tapThreadMutex);
+        tapThreadState = created ? TapThreadState::Running : TapThreadState::Failed;
+        runLoop = created ? CFRunLoopGetCurrent() : nullptr;
+    }
+    tapThreadChanged.notify_all();
+    
+    if (!created) {
+        return;
+    }
+    
+    // Run in slices so a stop request that lands before the loop starts
+    // spinning is still picked up
+    while (!tapStopRequested) {
+        CFRunLoopRunInMode(kCFRunLoopDefaultMode, 1.0, false);
+    }
+    
+    {
+        std::lock_guard<std::mutex> lock(tapThreadMutex);
+        runLoop = nullptr;
+        tapThreadState = TapThreadState::Stopped;
+    }
+    
+    windowObserver->detach();
+    destroyTaps();
+}
+
+bool EventMonitor::createTaps() {
+    // Listen-only taps: the recorder never modifies events, so the window
+    // server does not have to wait on us before delivering input
     
     // Create event taps for mouse events
     mouseEventTap = CGEventTapCreate(
         kCGSessionEventTap,
         kCGHeadInsertEventTap,
-        kCGEventTapOptionDefault,
+        kCGEventTapOptionListenOnly,
         CGEventMaskBit(kCGEventLeftMouseDown) | 
         CGEventMaskBit(kCGEventRightMouseDown) |
         CGEventMaskBit(kCGEventLeftMouseUp) |
         CGEventMaskBit(kCGEventRightMouseUp) |
         CGEventMaskBit(kCGEventLeftMouseDragged) |
         CGEventMaskBit(kCGEventRightMouseDragged) |
-        CGEventMaskBit(kCGEventMouseMoved),
+        CGEventMaskBit(kCGEventMouseMoved) |
+        CGEventMaskBit(kCGEventScrollWheel),
         mouseEventCallback,
         this
     );
@@ -52,7 +379,7 @@ bool EventMonitor::startRecording(const std::string& sessionId) {
     keyEventTap = CGEventTapCreate(
         kCGSessionEventTap,
         kCGHeadInsertEventTap,
-        kCGEventTapOptionDefault,
+        kCGEventTapOptionListenOnly,
         CGEventMaskBit(kCGEventKeyDown) | 
         CGEventMaskBit(kCGEventKeyUp) |
         CGEventMaskBit(kCGEventFlagsChanged),
@@ -64,132 +391,346 @@ bool EventMonitor::startRecording(const std::string& sessionId) {
         std::cerr << "Failed to create event taps. Make sure accessibility permissions are granted." << std::endl;
         std::cerr << "mouseEventTap: " << (mouseEventTap ? "OK" : "FAILED") << std::endl;
         std::cerr << "keyEventTap: " << (keyEventTap ? "OK" : "FAILED") << std::endl;
-        stopRecording();
+        destroyTaps();
         return false;
     }
     
-    std::cout << "Event taps created successfully!" << std::endl;
-    std::cout << "mouseEventTap: " << mouseEventTap << std::endl;
-    std::cout << "keyEventTap: " << keyEventTap << std::endl;
-    
     // Create run loop sources
     mouseRunLoopSource = CFMachPortCreateRunLoopSource(kCFAllocatorDefault, mouseEventTap, 0);
     keyRunLoopSource = CFMachPortCreateRunLoopSource(kCFAllocatorDefault, keyEventTap, 0);
     
-    // Get the current run loop
-    runLoop = CFRunLoopGetCurrent();
-    
-    // Add sources to run loop
-    CFRunLoopAddSource(runLoop, mouseRunLoopSource, kCFRunLoopCommonModes);
-    CFRunLoopAddSource(runLoop, keyRunLoopSource, kCFRunLoopCommonModes);
+    // Attach to this thread's run loop, not the JS thread's
+    CFRunLoopRef tapRunLoop = CFRunLoopGetCurrent();
+    CFRunLoopAddSource(tapRunLoop, mouseRunLoopSource, kCFRunLoopCommonModes);
+    CFRunLoopAddSource(tapRunLoop, keyRunLoopSource, kCFRunLoopCommonModes);
     
     // Enable the event taps
     CGEventTapEnable(mouseEventTap, true);
     CGEventTapEnable(keyEventTap, true);
     
-    isRecording = true;
     return true;
 }
 
-void EventMonitor::stopRecording() {
-    if (!isRecording) {
-        return;
-    }
-    
-    isRecording = false;
-    
+void EventMonitor::destroyTaps() {
     if (mouseEventTap) {
         CGEventTapEnable(mouseEventTap, false);
-        CFRelease(mouseEventTap);
-        mouseEventTap = nullptr;
     }
     
     if (keyEventTap) {
         CGEventTapEnable(keyEventTap, false);
-        CFRelease(keyEventTap);
-        keyEventTap = nullptr;
     }
     
+    CFRunLoopRef tapRunLoop = CFRunLoopGetCurrent();
+    
     if (mouseRunLoopSource) {
-        CFRunLoopRemoveSource(runLoop, mouseRunLoopSource, kCFRunLoopCommonModes);
+        CFRunLoopRemoveSource(tapRunLoop, mouseRunLoopSource, kCFRunLoopCommonModes);
         CFRelease(mouseRunLoopSource);
         mouseRunLoopSource = nullptr;
     }
     
     if (keyRunLoopSource) {
-        CFRunLoopRemoveSource(runLoop, keyRunLoopSource, kCFRunLoopCommonModes);
+        CFRunLoopRemoveSource(tapRunLoop, keyRunLoopSource, kCFRunLoopCommonModes);
         CFRelease(keyRunLoopSource);
         keyRunLoopSource = nullptr;
     }
     
-    runLoop = nullptr;
+    if (mouseEventTap) {
+        CFRelease(mouseEventTap);
+        mouseEventTap = nullptr;
+    }
+    
+    if (keyEventTap) {
+        CFRelease(keyEventTap);
+        keyEventTap = nullptr;
+    }
+}
+
+void EventMonitor::recoverTap(CFMachPortRef tap, CGEventType reason) {
+    // The window server disables a tap whose callback is too slow, or when
+    // secure input toggles it off; turn it back on and keep count
+    if (reason == kCGEventTapDisabledByTimeout) {
+        timeoutRecoveries++;
+    } else {
+        userInputRecoveries++;
+    }
+    lastRecoveryAt = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()
+    ).count();
+    
+    if (tap) {
+        CGEventTapEnable(tap, true);
+    }
 }
 
-void EventMonitor::setStepCallback(std::function<void(const RecordedStep&)> callback) {
-    std::cout << "setStepCallback called, callback=" << (callback ? "YES" : "NO") << std::endl;
-    stepCallback = callback;
+ElementIndexStats EventMonitor::getIndexStats() const {
+    std::lock_guard<std::mutex> lock(frameIndexMutex);
+    return frameIndex.getStats();
+}
+
+PrefetchStats EventMonitor::getPrefetchStats() const {
+    return prefetcher->getStats();
+}
+
+TapStats EventMonitor::getTapStats() const {
+    TapStats stats;
+    stats.timeoutRecoveries = timeoutRecoveries.load();
+    stats.userInputRecoveries = userInputRecoveries.load();
+    stats.lastRecoveryAt = lastRecoveryAt.load();
+    return stats;
 }
 
 CGEventRef EventMonitor::mouseEventCallback(CGEventTapProxy proxy, CGEventType type, CGEventRef event, void* refcon) {
     EventMonitor* monitor = static_cast<EventMonitor*>(refcon);
+    if (type == kCGEventTapDisabledByTimeout || type == kCGEventTapDisabledByUserInput) {
+        monitor->recoverTap(monitor->mouseEventTap, type);
+        return event;
+    }
     return monitor->handleMouseEvent(type, event);
 }
 
 CGEventRef EventMonitor::keyEventCallback(CGEventTapProxy proxy, CGEventType type, CGEventRef event, void* refcon) {
     EventMonitor* monitor = static_cast<EventMonitor*>(refcon);
+    if (type == kCGEventTapDisabledByTimeout || type == kCGEventTapDisabledByUserInput) {
+        monitor->recoverTap(monitor->keyEventTap, type);
+        return event;
+    }
     return monitor->handleKeyEvent(type, event);
 }
 
-CGEventRef EventMonitor::handleMouseEvent(CGEventType type, CGEventRef event) {
+void EventMonitor::dispatch(const std::vector<const Subscriber*>& targets, RecordedStep& step,
+                            AXUIElementRef element) {
+    AXElementInfo elementInfo;
+    std::string role;
+    bool hasElement = element != nullptr;
+    if (hasElement) {
+        elementInfo.setElement(element);
+        CFRelease(element);
+        role = elementInfo.getStringAttribute(kAXRoleAttribute);
+    }
     
-    if (!isRecording || !stepCallback) {
-        std::cout << "EARLY RETURN: Not recording or no callback" << std::endl;
-        return event;
+    // Role filters need only the role attribute; the rest of the descriptor is
+    // resolved once, and only if some subscriber still wants the step
+    bool wanted = std::any_of(targets.begin(), targets.end(),
+        [&role](const Subscriber* s) { return s->matchesRole(role); });
+    if (!wanted) {
+        return;
     }
-        
-    CGPoint location = CGEventGetLocation(event);
     
-    RecordedStep step;
-    step.timestamp = std::chrono::duration_cast<std::chrono::milliseconds>(
-        std::chrono::system_clock::now().time_since_epoch()
-    ).count();
-    step.sessionId = sessionId;
+    step.targetDescriptor.role = role;
+    if (hasElement) {
+        elementInfo.describe(step.targetDescriptor, false);
+    }
     
-    // Get AX element at the click point
-    AXUIElementRef element = AXElementInfo::getElementAtPoint(location);
-    if (element) {
-        AXElementInfo elementInfo;
-        elementInfo.setElement(element);
-        
-        step.targetDescriptor.role = elementInfo.getStringAttribute(kAXRoleAttribute);
-        step.targetDescriptor.title = elementInfo.getStringAttribute(kAXTitleAttribute);
-        step.targetDescriptor.identifier = elementInfo.getStringAttribute(kAXIdentifierAttribute);
-        step.targetDescriptor.value = elementInfo.getStringAttribute(kAXValueAttribute);
-        step.targetDescriptor.ancestry = elementInfo.getAncestryPath();
+    deliver(targets, step);
+    
+    // Subscribers already have the step; remember the frame for later clicks
+    if (hasElement) {
+        indexElement(elementInfo.getElement(), step.targetDescriptor);
+    }
+}
+
+void EventMonitor::indexElement(AXUIElementRef element, const TargetDescriptor& descriptor) {
+    if (descriptor.frame.width <= 0 || descriptor.frame.height <= 0) {
+        return;
+    }
+    queueIndexTask({{AXElementHandle(element), descriptor}, false, CGPointZero, 0});
+}
+
+void EventMonitor::verifyHit(const IndexedElement& indexed, CGPoint location, pid_t processId) {
+    queueIndexTask({indexed, true, location, processId});
+}
+
+void EventMonitor::queueIndexTask(IndexTask task) {
+    {
+        std::lock_guard<std::mutex> lock(indexQueueMutex);
+        if (indexStopRequested) {
+            return;
+        }
+        // Under a burst the oldest tasks are the least useful ones
+        if (indexQueue.size() >= kIndexQueueCapacity) {
+            indexQueue.pop_front();
+        }
+        indexQueue.push_back(std::move(task));
+    }
+    indexQueueChanged.notify_one();
+}
+
+void EventMonitor::runIndexThread() {
+    // Only makes later clicks cheaper; never compete with the tap thread
+    pthread_set_qos_class_self_np(QOS_CLASS_UTILITY, 0);
+    
+    std::unique_lock<std::mutex> lock(indexQueueMutex);
+    while (true) {
+        indexQueueChanged.wait(lock, [this] { return indexStopRequested || !indexQueue.empty(); });
+        if (indexStopRequested) {
+            return;
+        }
         
-        CGRect frame = elementInfo.getFrame();
-        step.targetDescriptor.frame = {
-            static_cast<int>(frame.origin.x),
-            static_cast<int>(frame.origin.y),
-            static_cast<int>(frame.size.width),
-            static_cast<int>(frame.size.height)
-        };
+        IndexTask task = std::move(indexQueue.front());
+        indexQueue.pop_front();
+        lock.unlock();
+        if (task.verify) {
+            checkHit(task);
+        } else {
+            insertIndexed(task.indexed);
+        }
+        lock.lock();
+    }
+}
+
+void EventMonitor::insertIndexed(const IndexedElement& indexed) {
+    // A container's frame also covers children that were never resolved, so
+    // only leaves can answer a click without asking AX what is at the point
+    CFIndex children = 0;
+    AXError childrenError = AXUIElementGetAttributeValueCount(indexed.element.get(), kAXChildrenAttribute, &children);
+    if (childrenError == kAXErrorSuccess && children > 0) {
+        return;
+    }
+    
+    AXUIElementRef window = nullptr;
+    AXError error = AXUIElementCopyAttributeValue(indexed.element.get(), kAXWindowAttribute, reinterpret_cast<CFTypeRef*>(&window));
+    if (error != kAXErrorSuccess || !window) {
+        return;
+    }
+    
+    pid_t pid = 0;
+    AXUIElementGetPid(window, &pid);
+    
+    AXElementInfo windowInfo;
+    windowInfo.setElement(window);
+    CGRect windowFrame = windowInfo.getFrame();
+    
+    windowObserver->observe(pid, window);
+    uint64_t windowId = WindowObserver::windowId(window);
+    CFRelease(window);
+    
+    const Frame& frame = indexed.descriptor.frame;
+    std::lock_guard<std::mutex> lock(frameIndexMutex);
+    frameIndex.insert(
+        windowId,
+        static_cast<int>(pid),
+        {
+            static_cast<int>(windowFrame.origin.x),
+            static_cast<int>(windowFrame.origin.y),
+            static_cast<int>(windowFrame.size.width),
+            static_cast<int>(windowFrame.size.height)
+        },
+        {frame.x, frame.y, frame.width, frame.height},
+        indexed,
+        steadyMicros());
+}
+
+void EventMonitor::checkHit(const IndexTask& task) {
+    AXUIElementRef atPoint = AXElementInfo::getElementAtPoint(task.location);
+    bool matches = atPoint && task.indexed.element.matches(atPoint);
+    if (atPoint) {
+        CFRelease(atPoint);
+    }
+    if (matches) {
+        return;
+    }
+    
+    // The step already went out; keep the entry from answering the next click
+    std::lock_guard<std::mutex> lock(frameIndexMutex);
+    frameIndex.removeEntries(static_cast<int>(task.processId), [&task](const IndexedElement& indexed) {
+        return indexed.element.matches(task.indexed.element.get());
+    });
+}
+
+bool EventMonitor::lookupIndex(CGPoint location, int processId, TargetDescriptor& descriptor) {
+    IndexedElement indexed;
+    {
+        std::lock_guard<std::mutex> lock(frameIndexMutex);
+        ElementIndex<IndexedElement>::Hit hit;
+        if (!frameIndex.hitTest(static_cast<int>(location.x), static_cast<int>(location.y), processId,
+                                steadyMicros(), hit)) {
+            return false;
+        }
         
-        CFRelease(element);
+        indexed = *hit.payload;
+        indexed.descriptor.frame = {hit.frame.x, hit.frame.y, hit.frame.width, hit.frame.height};
     }
     
-    step.location = {static_cast<int>(location.x), static_cast<int>(location.y)};
+    descriptor = indexed.descriptor;
+    verifyHit(indexed, location, static_cast<pid_t>(processId));
+    return true;
+}
+
+void EventMonitor::onScrolled(CGPoint location) {
+    // Scrolled content keeps its elements but moves their frames
+    {
+        std::lock_guard<std::mutex> lock(frameIndexMutex);
+        frameIndex.resetWindowAt(static_cast<int>(location.x), static_cast<int>(location.y));
+    }
+    prefetcher->invalidate();
+}
+
+void EventMonitor::onWindowChanged(pid_t pid, uint64_t windowId, WindowChange change, const Frame& frame,
+                                   AXUIElementRef element) {
+    if (change == WindowChange::Layout) {
+        prefetcher->invalidate();
+    }
+    
+    std::lock_guard<std::mutex> lock(frameIndexMutex);
+    
+    switch (change) {
+        case WindowChange::Destroyed:
+            frameIndex.removeWindow(windowId);
+            break;
+        case WindowChange::Raised:
+            frameIndex.raiseWindow(windowId, steadyMicros());
+            frameIndex.updateWindow(windowId, {frame.x, frame.y, frame.width, frame.height});
+            break;
+        case WindowChange::Frame:
+            frameIndex.updateWindow(windowId, {frame.x, frame.y, frame.width, frame.height});
+            break;
+        case WindowChange::Layout:
+            // Reported for a window, or for the app when no window applies
+            if (!frameIndex.clearWindow(windowId)) {
+                frameIndex.removeOwner(static_cast<int>(pid));
+            }
+            break;
+        case WindowChange::Value:
+            // Typing and clock ticks change one element; only its entry is stale
+            frameIndex.removeEntries(static_cast<int>(pid), [element](const IndexedElement& indexed) {
+                return indexed.element.matches(element);
+            });
+            break;
+    }
+}
+
+void EventMonitor::deliver(const std::vector<const Subscriber*>& targets, RecordedStep& step) {
+    for (const Subscriber* subscriber : targets) {
+        if (!subscriber->matchesRole(step.targetDescriptor.role)) {
+            continue;
+        }
+        // The snapshot may predate a stop or unsubscribe; the gate has the
+        // current state. Callbacks must not call back into the monitor,
+        // since closing the gate waits for them.
+        DeliveryGate& gate = *subscriber->gate;
+        gate.inFlight.fetch_add(1);
+        if (gate.open.load()) {
+            step.sessionId = gate.sessionId;
+            subscriber->callback(step);
+        }
+        gate.inFlight.fetch_sub(1, std::memory_order_release);
+    }
+}
+
+CGEventRef EventMonitor::handleMouseEvent(CGEventType type, CGEventRef event) {
+    RecordedStep step;
+    uint32_t action;
     
     switch (type) {
         case kCGEventLeftMouseDown:
             step.action = "click";
             step.button = "left";
-            std::cout << "Recording left click at (" << location.x << ", " << location.y << ")" << std::endl;
+            action = kStepActionClick;
             break;
         case kCGEventRightMouseDown:
             step.action = "click";
             step.button = "right";
-            std::cout << "Recording right click at (" << location.x << ", " << location.y << ")" << std::endl;
+            action = kStepActionClick;
             break;
         case kCGEventLeftMouseUp:
         case kCGEventRightMouseUp:
@@ -199,43 +740,124 @@ CGEventRef EventMonitor::handleMouseEvent(CGEventType type, CGEventRef event) {
         case kCGEventRightMouseDragged:
             step.action = "drag";
             step.button = (type == kCGEventLeftMouseDragged) ? "left" : "right";
-            std::cout << "Recording drag at (" << location.x << ", " << location.y << ")" << std::endl;
+            action = kStepActionDrag;
             break;
         case kCGEventMouseMoved:
-            // Skip regular mouse moves to avoid noise
+            // Moves are not recorded, but they tell the prefetcher where the cursor rests
+            prefetcher->onMouseMoved(CGEventGetLocation(event));
+            return event;
+        case kCGEventScrollWheel:
+            onScrolled(CGEventGetLocation(event));
             return event;
         default:
-            std::cout << "Ignoring unknown event type: " << type << std::endl;
             return event;
     }
     
+    SubscriberSnapshot subscribers(*this);
+    if ((subscribers->activeActionMask & action) == 0) {
+        return event;
+    }
+    
+    CGPoint location = CGEventGetLocation(event);
+    
+    std::vector<const Subscriber*> targets;
+    for (const auto& subscriber : subscribers->subscribers) {
+        if (subscriber->matchesPointer(action, location)) {
+            targets.push_back(subscriber.get());
+        }
+    }
+    
+    if (targets.empty()) {
+        return event;
+    }
+    
     // Get the current application
     step.appInfo = getCurrentApplication();
+    targets.erase(
+        std::remove_if(targets.begin(), targets.end(),
+            [&step](const Subscriber* s) { return !s->matchesApp(step.appInfo); }),
+        targets.end());
+    
+    if (targets.empty()) {
+        return event;
+    }
     
-    std::cout << "Calling stepCallback with step: " << step.action << std::endl;
-    stepCallback(step);
-    std::cout << "stepCallback completed" << std::endl;
+    step.timestamp = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()
+    ).count();
+    step.location = {static_cast<int>(location.x), static_cast<int>(location.y)};
+    
+    if (action != kStepActionClick) {
+        // Get AX element at the drag point
+        dispatch(targets, step, AXElementInfo::getElementAtPoint(location));
+        return event;
+    }
+    
+    // A leaf already seen in the same window answers without any AX call and
+    // is checked afterwards on the index thread. Otherwise the element at the
+    // point is asked for; when it was prefetched during hover, its cached
+    // descriptor replaces most attribute reads.
+    auto startedAt = std::chrono::steady_clock::now();
+    bool hit = lookupIndex(location, step.appInfo.processId, step.targetDescriptor);
+    if (hit) {
+        deliver(targets, step);
+    } else {
+        AXUIElementRef element = AXElementInfo::getElementAtPoint(location);
+        hit = element && prefetcher->lookup(location, element, step.targetDescriptor);
+        if (hit) {
+            CFRelease(element);
+            deliver(targets, step);
+        } else {
+            dispatch(targets, step, element);
+        }
+    }
+    prefetcher->recordLatency(hit, std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - startedAt
+    ).count());
     return event;
 }
 
 CGEventRef EventMonitor::handleKeyEvent(CGEventType type, CGEventRef event) {
-    if (!isRecording || !stepCallback) {
+    if (type != kCGEventKeyDown) {
+        return event; // Only process key down events
+    }
+    
+    SubscriberSnapshot subscribers(*this);
+    if ((subscribers->activeActionMask & kStepActionType) == 0) {
         return event;
     }
     
-    if (type != kCGEventKeyDown) {
-        return event; // Only process key down events
+    CGPoint location = CGEventGetLocation(event);
+    
+    std::vector<const Subscriber*> targets;
+    for (const auto& subscriber : subscribers->subscribers) {
+        if (subscriber->matchesPointer(kStepActionType, location)) {
+            targets.push_back(subscriber.get());
+        }
     }
     
-    CGKeyCode keyCode = static_cast<CGKeyCode>(CGEventGetIntegerValueField(event, kCGKeyboardEventKeycode));
-    CGEventFlags flags = CGEventGetFlags(event);
+    if (targets.empty()) {
+        return event;
+    }
     
     RecordedStep step;
+    step.appInfo = getCurrentApplication();
+    targets.erase(
+        std::remove_if(targets.begin(), targets.end(),
+            [&step](const Subscriber* s) { return !s->matchesApp(step.appInfo); }),
+        targets.end());
+    
+    if (targets.empty()) {
+        return event;
+    }
+    
+    CGEventFlags flags = CGEventGetFlags(event);
+    
     step.timestamp = std::chrono::duration_cast<std::chrono::milliseconds>(
         std::chrono::system_clock::now().time_since_epoch()
     ).count();
-    step.sessionId = sessionId;
     step.action = "type";
+    step.location = {static_cast<int>(location.x), static_cast<int>(location.y)};
     
     // Get the character representation
     UniChar unicodeString[4];
@@ -269,30 +891,7 @@ CGEventRef EventMonitor::handleKeyEvent(CGEventType type, CGEventRef event) {
     step.modifiers.command = (flags & kCGEventFlagMaskCommand) != 0;
     
     // Get focused element for typing events
-    AXUIElementRef focusedElement = getFocusedElement();
-    if (focusedElement) {
-        AXElementInfo elementInfo;
-        elementInfo.setElement(focusedElement);
-        
-        step.targetDescriptor.role = elementInfo.getStringAttribute(kAXRoleAttribute);
-        step.targetDescriptor.title = elementInfo.getStringAttribute(kAXTitleAttribute);
-        step.targetDescriptor.identifier = elementInfo.getStringAttribute(kAXIdentifierAttribute);
-        step.targetDescriptor.value = elementInfo.getStringAttribute(kAXValueAttribute);
-        step.targetDescriptor.ancestry = elementInfo.getAncestryPath();
-        
-        CGRect frame = elementInfo.getFrame();
-        step.targetDescriptor.frame = {
-            static_cast<int>(frame.origin.x),
-            static_cast<int>(frame.origin.y),
-            static_cast<int>(frame.size.width),
-            static_cast<int>(frame.size.height)
-        };
-        
-        CFRelease(focusedElement);
-    }
-    
-    step.appInfo = getCurrentApplication();
-    stepCallback(step);
+    dispatch(targets, step, getFocusedElement());
     
     return event;
 }
@@ -6,83 +6,191 @@
 #include <functional>
 #include <chrono>
 #include <vector>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <unordered_set>
+#include "ax_element.h"
+#include "element_index.h"
+#include "recorder_types.h"
 
-struct AXPoint {
-    int x;
-    int y;
-};
-
-struct Frame {
-    int x;
-    int y;
-    int width;
-    int height;
-};
-
-struct Modifiers {
-    bool shift = false;
-    bool control = false;
-    bool option = false;
-    bool command = false;
-};
+// Window events reported by WindowObserver. Layout and Value carry the element
+// that changed (a window or the app for Layout) and no frame.
+enum class WindowChange { Frame, Raised, Destroyed, Layout, Value };
 
-struct ApplicationInfo {
-    std::string name;
-    int processId;
-};
+class HoverPrefetcher;
+class WindowObserver;
 
-struct TargetDescriptor {
-    std::string role;
-    std::string title;
-    std::string identifier;
-    std::string value;
-    Frame frame;
-    std::vector<std::string> ancestry;
-};
-
-struct RecordedStep {
-    long long timestamp;
-    std::string sessionId;
-    std::string action;
-    std::string button;
-    std::string text;
-    AXPoint location;
-    Modifiers modifiers;
-    TargetDescriptor targetDescriptor;
-    ApplicationInfo appInfo;
-};
+using SubscriptionId = uint64_t;
 
 class EventMonitor {
 public:
     static EventMonitor* getInstance();
-    
-    bool startRecording(const std::string& sessionId);
-    void stopRecording();
-    bool isRecordingActive() const { return isRecording; }
-    
-    void setStepCallback(std::function<void(const RecordedStep&)> callback);
-    
+
+    SubscriptionId subscribe(const EventFilter& filter, StepCallback callback);
+    void unsubscribe(SubscriptionId id);
+
+    bool startRecording(SubscriptionId id, const std::string& sessionId);
+    void stopRecording(SubscriptionId id);
+    bool isRecordingActive(SubscriptionId id) const;
+    TapStats getTapStats() const;
+    PrefetchStats getPrefetchStats() const;
+    ElementIndexStats getIndexStats() const;
+
 private:
+    // Recording state shared by every published copy of one subscriber.
+    // deliver() counts itself in, then checks `open`; closing clears `open`
+    // and waits for the count to drain, so once stopRecording() or
+    // unsubscribe() returns no further step reaches the callback. sessionId
+    // is only written while the gate is closed and drained.
+    struct DeliveryGate {
+        std::atomic<bool> open{false};
+        std::atomic<uint32_t> inFlight{0};
+        std::string sessionId;
+
+        void close();
+    };
+
+    // A filter compiled once at subscribe time so matching is cheap on the tap thread
+    struct Subscriber {
+        SubscriptionId id;
+        EventFilter filter;
+        std::unordered_set<std::string> roleSet;
+        bool active;
+        StepCallback callback;
+        std::shared_ptr<DeliveryGate> gate;
+
+        bool matchesPointer(uint32_t action, CGPoint location) const;
+        bool matchesApp(const ApplicationInfo& appInfo) const;
+        bool matchesRole(const std::string& role) const;
+    };
+
+    // Immutable snapshot published to the event callbacks
+    struct SubscriberList {
+        std::vector<std::shared_ptr<const Subscriber>> subscribers;
+        uint32_t activeActionMask = 0;
+        size_t activeCount = 0;
+    };
+
+    // Frame index payload. Only leaf elements are indexed, so a hit is the
+    // innermost element under the point and is delivered without asking AX.
+    struct IndexedElement {
+        AXElementHandle element;
+        TargetDescriptor descriptor;
+    };
+
+    // Work for the index thread: insert a resolved element, or check after
+    // the fact that an index hit was the element at its click point
+    struct IndexTask {
+        IndexedElement indexed;
+        bool verify;
+        CGPoint location;
+        pid_t processId;
+    };
+
+    // Keeps the current SubscriberList alive for the duration of one event
+    // dispatch by publishing it in a hazard slot; writers swap in a new list
+    // without waiting, and free old ones once no slot names them
+    class SubscriberSnapshot {
+    public:
+        explicit SubscriberSnapshot(const EventMonitor& monitor);
+        ~SubscriberSnapshot();
+        SubscriberSnapshot(const SubscriberSnapshot&) = delete;
+        SubscriberSnapshot& operator=(const SubscriberSnapshot&) = delete;
+        const SubscriberList* operator->() const { return list; }
+
+    private:
+        const EventMonitor& monitor;
+        size_t slot;
+        const SubscriberList* list;
+    };
+
     EventMonitor();
     ~EventMonitor();
-    
+
     static EventMonitor* instance;
     static CGEventRef mouseEventCallback(CGEventTapProxy proxy, CGEventType type, CGEventRef event, void* refcon);
     static CGEventRef keyEventCallback(CGEventTapProxy proxy, CGEventType type, CGEventRef event, void* refcon);
-    
+
     CGEventRef handleMouseEvent(CGEventType type, CGEventRef event);
     CGEventRef handleKeyEvent(CGEventType type, CGEventRef event);
+
+    void dispatch(const std::vector<const Subscriber*>& targets, RecordedStep& step,
+                  AXUIElementRef element);
+    void deliver(const std::vector<const Subscriber*>& targets, RecordedStep& step);
     
+    // Local point-to-element lookups, fed by every element resolved over AX.
+    // indexElement() and verifyHit() only queue; the AX calls they need run
+    // on the index thread.
+    void indexElement(AXUIElementRef element, const TargetDescriptor& descriptor);
+    void verifyHit(const IndexedElement& indexed, CGPoint location, pid_t processId);
+    void queueIndexTask(IndexTask task);
+    void runIndexThread();
+    void insertIndexed(const IndexedElement& indexed);
+    void checkHit(const IndexTask& task);
+    bool lookupIndex(CGPoint location, int processId, TargetDescriptor& descriptor);
+    void onScrolled(CGPoint location);
+    void onWindowChanged(pid_t pid, uint64_t windowId, WindowChange change, const Frame& frame,
+                         AXUIElementRef element);
+    void publish(std::unique_ptr<SubscriberList> list);
+    void reclaimSubscriberLists();
+    std::unique_ptr<SubscriberList> copySubscribers() const;
+
+    // Taps live on a dedicated thread with its own run loop so a busy JS
+    // thread never delays input delivery
+    bool startTaps();
+    void stopTaps();
+    void runTapThread();
+    bool createTaps();
+    void destroyTaps();
+    void recoverTap(CFMachPortRef tap, CGEventType reason);
+
     AXUIElementRef getFocusedElement();
     ApplicationInfo getCurrentApplication();
-    
+
     bool isRecording;
-    std::string sessionId;
     CFMachPortRef mouseEventTap;
     CFMachPortRef keyEventTap;
     CFRunLoopRef runLoop;
     CFRunLoopSourceRef mouseRunLoopSource;
     CFRunLoopSourceRef keyRunLoopSource;
     
-    std::function<void(const RecordedStep&)> stepCallback;
-};
\ No newline at end of file
+    enum class TapThreadState { Stopped, Starting, Running, Failed };
+    std::thread tapThread;
+    std::mutex tapThreadMutex;
+    std::condition_variable tapThreadChanged;
+    TapThreadState tapThreadState;
+    std::atomic<bool> tapStopRequested;
+    
+    std::atomic<uint64_t> timeoutRecoveries;
+    std::atomic<uint64_t> userInputRecoveries;
+    std::atomic<long long> lastRecoveryAt;
+    
+    std::unique_ptr<HoverPrefetcher> prefetcher;
+    std::unique_ptr<WindowObserver> windowObserver;
+    mutable std::mutex frameIndexMutex;
+    ElementIndex<IndexedElement> frameIndex;
+    
+    static constexpr size_t kIndexQueueCapacity = 64;
+    std::thread indexThread;
+    std::mutex indexQueueMutex;
+    std::condition_variable indexQueueChanged;
+    std::deque<IndexTask> indexQueue;
+    bool indexStopRequested;
+
+    // Writers serialize on subscribersMutex and swap in a new list. Readers
+    // take no lock: they claim a hazard slot, name the list they loaded in
+    // it and re-check the pointer. The tap thread and the odd JS-thread
+    // isRecordingActive() are the only readers, so a few slots suffice.
+    static constexpr size_t kHazardSlots = 4;
+    std::mutex subscribersMutex;
+    std::atomic<const SubscriberList*> subscriberList;
+    mutable std::atomic<bool> hazardClaimed[kHazardSlots];
+    mutable std::atomic<const SubscriberList*> hazards[kHazardSlots];
+    std::vector<const SubscriberList*> retiredLists; // Guarded by subscribersMutex
+    SubscriptionId nextSubscriptionId;
+};
@@ -0,0 +1,270 @@
+#include "flow_batch.h"
+#include "batch_engine.h"
+#include <memory>
+
+class FlowBatch : public Napi::ObjectWrap<FlowBatch> {
+public:
+    static Napi::Object Init(Napi::Env env, Napi::Object exports);
+    FlowBatch(const Napi::CallbackInfo& info);
+    ~FlowBatch();
+    
+    Napi::Value NextRows(const Napi::CallbackInfo& info);
+    Napi::Value CompleteRow(const Napi::CallbackInfo& info);
+    Napi::Value Cancel(const Napi::CallbackInfo& info);
+    Napi::Value IsDone(const Napi::CallbackInfo& info);
+    Napi::Value GetColumns(const Napi::CallbackInfo& info);
+    Napi::Value GetProgress(const Napi::CallbackInfo& info);
+    Napi::Value GetCheckpoint(const Napi::CallbackInfo& info);
+    Napi::Value TakeRowTimings(const Napi::CallbackInfo& info);
+
+private:
+    static bool ConfigFromJS(const Napi::Object& options, BatchConfig& config, std::string& error);
+    static std::string StringField(const Napi::Object& object, const char* name);
+    
+    std::unique_ptr<BatchEngine> engine;
+    size_t stepCount;
+    // Handed back to the engine on the next call so row buffers are reused
+    std::vector<BoundRow> rows;
+};
+
+static double NanosToMicros(uint64_t nanos) {
+    return static_cast<double>(nanos) / 1000.0;
+}
+
+Napi::Object FlowBatch::Init(Napi::Env env, Napi::Object exports) {
+    Napi::Function func = DefineClass(env, "FlowBatch", {
+        InstanceMethod("nextRows", &FlowBatch::NextRows),
+        InstanceMethod("completeRow", &FlowBatch::CompleteRow),
+        InstanceMethod("cancel", &FlowBatch::Cancel),
+        InstanceMethod("isDone", &FlowBatch::IsDone),
+        InstanceMethod("getColumns", &FlowBatch::GetColumns),
+        InstanceMethod("getProgress", &FlowBatch::GetProgress),
+        InstanceMethod("getCheckpoint", &FlowBatch::GetCheckpoint),
+        InstanceMethod("takeRowTimings", &FlowBatch::TakeRowTimings)
+    });
+    
+    exports.Set("FlowBatch", func);
+    return exports;
+}
+
+FlowBatch::FlowBatch(const Napi::CallbackInfo& info) : Napi::ObjectWrap<FlowBatch>(info), stepCount(0) {
+    Napi::Env env = info.Env();
+    engine.reset(new BatchEngine());
+    
+    if (info.Length() < 1 || !info[0].IsObject()) {
+        Napi::TypeError::New(env, "Batch options object expected").ThrowAsJavaScriptException();
+        return;
+    }
+    
+    BatchConfig config;
+    std::string error;
+    if (!ConfigFromJS(info[0].As<Napi::Object>(), config, error)) {
+        Napi::TypeError::New(env, error).ThrowAsJavaScriptException();
+        return;
+    }
+    
+    stepCount = config.steps.size();
+    if (!engine->start(config, error)) {
+        Napi::Error::New(env, error).ThrowAsJavaScriptException();
+        return;
+    }
+}
+
+FlowBatch::~FlowBatch() {
+    engine->cancel();
+}
+
+std::string FlowBatch::StringField(const Napi::Object& object, const char* name) {
+    if (object.Has(name) && object.Get(name).IsString()) {
+        return object.Get(name).As<Napi::String>().Utf8Value();
+    }
+    return std::string();
+}
+
+bool FlowBatch::ConfigFromJS(const Napi::Object& options, BatchConfig& config, std::string& error) {
+    config.path = StringField(options, "path");
+    if (config.path.empty()) {
+        error = "Batch path string expected";
+        return false;
+    }
+    
+    std::string delimiter = StringField(options, "delimiter");
+    if (delimiter.size() > 1) {
+        error = "Batch delimiter must be a single character";
+        return false;
+    }
+    config.delimiter = delimiter.empty() ? 0 : delimiter[0];
+    config.tableVariable = StringField(options, "tableVariable");
+    
+    if (options.Has("variables") && options.Get("variables").IsObject()) {
+        Napi::Object variables = options.Get("variables").As<Napi::Object>();
+        Napi::Array names = variables.GetPropertyNames();
+        for (uint32_t i = 0; i < names.Length(); i++) {
+            Napi::Value name = names.Get(i);
+            config.variables.emplace_back(name.ToString().Utf8Value(),
+                                          variables.Get(name).ToString().Utf8Value());
+        }
+    }
+    
+    if (!options.Has("steps") || !options.Get("steps").IsArray()) {
+        error = "Batch steps array expected";
+        return false;
+    }
+    Napi::Array steps = options.Get("steps").As<Napi::Array>();
+    for (uint32_t i = 0; i < steps.Length(); i++) {
+        BatchStepTemplate step;
+        if (steps.Get(i).IsObject()) {
+            Napi::Object source = steps.Get(i).As<Napi::Object>();
+            step.hasSelector = source.Has("selector") && source.Get("selector").IsString();
+            step.hasText = source.Has("text") && source.Get("text").IsString();
+            step.hasUrl = source.Has("url") && source.Get("url").IsString();
+            step.selector = StringField(source, "selector");
+            step.text = StringField(source, "text");
+            step.url = StringField(source, "url");
+        }
+        config.steps.push_back(step);
+    }
+    
+    if (options.Has("resumeFrom") && options.Get("resumeFrom").IsObject()) {
+        Napi::Object resume = options.Get("resumeFrom").As<Napi::Object>();
+        if (resume.Has("row") && resume.Get("row").IsNumber()) {
+            config.startRow = static_cast<uint64_t>(resume.Get("row").As<Napi::Number>().Int64Value());
+        }
+        if (resume.Has("byteOffset") && resume.Get("byteOffset").IsNumber()) {
+            config.startOffset = static_cast<uint64_t>(resume.Get("byteOffset").As<Napi::Number>().Int64Value());
+        }
+    }
+    
+    if (options.Has("queueCapacity") && options.Get("queueCapacity").IsNumber()) {
+        config.queueCapacity = options.Get("queueCapacity").As<Napi::Number>().Uint32Value();
+    }
+    
+    return true;
+}
+
+Napi::Value FlowBatch::NextRows(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    
+    size_t maxRows = 64;
+    if (info.Length() > 0 && info[0].IsNumber()) {
+        maxRows = info[0].As<Napi::Number>().Uint32Value();
+    }
+    
+    size_t count = engine->next(rows, maxRows);
+    const std::vector<BatchSlot>& slots = engine->slots();
+    static const char* const kFieldNames[] = {"selector", "text", "url"};
+    
+    Napi::Array result = Napi::Array::New(env, count);
+    for (size_t i = 0; i < count; i++) {
+        const BoundRow& row = rows[i];
+        
+        Napi::Array steps = Napi::Array::New(env, stepCount);
+        for (size_t step = 0; step < stepCount; step++) {
+            steps[step] = Napi::Object::New(env);
+        }
+        for (size_t slot = 0; slot < slots.size(); slot++) {
+            std::string_view value = row.value(slot);
+            steps.Get(slots[slot].step).As<Napi::Object>().Set(
+                kFieldNames[slots[slot].field], Napi::String::New(env, value.data(), value.size()));
+        }
+        
+        Napi::Object obj = Napi::Object::New(env);
+        obj.Set("row", Napi::Number::New(env, static_cast<double>(row.row)));
+        obj.Set("byteOffset", Napi::Number::New(env, static_cast<double>(row.offset)));
+        obj.Set("steps", steps);
+        result[i] = obj;
+    }
+    
+    return result;
+}
+
+Napi::Value FlowBatch::CompleteRow(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    
+    if (info.Length() < 1 || !info[0].IsNumber()) {
+        Napi::TypeError::New(env, "Row number expected").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    
+    uint64_t row = static_cast<uint64_t>(info[0].As<Napi::Number>().Int64Value());
+    bool ok = info.Length() < 2 || !info[1].IsBoolean() || info[1].As<Napi::Boolean>().Value();
+    
+    return Napi::Boolean::New(env, engine->complete(row, ok));
+}
+
+Napi::Value FlowBatch::Cancel(const Napi::CallbackInfo& info) {
+    engine->cancel();
+    return Napi::Boolean::New(info.Env(), true);
+}
+
+Napi::Value FlowBatch::IsDone(const Napi::CallbackInfo& info) {
+    return Napi::Boolean::New(info.Env(), engine->finished());
+}
+
+Napi::Value FlowBatch::GetColumns(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    
+    const std::vector<std::string>& columns = engine->columns();
+    Napi::Array result = Napi::Array::New(env, columns.size());
+    for (size_t i = 0; i < columns.size(); i++) {
+        result[i] = Napi::String::New(env, columns[i]);
+    }
+    
+    return result;
+}
+
+Napi::Value FlowBatch::GetProgress(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    
+    BatchProgress progress = engine->progress();
+    
+    Napi::Object obj = Napi::Object::New(env);
+    obj.Set("rowsParsed", Napi::Number::New(env, static_cast<double>(progress.rowsParsed)));
+    obj.Set("rowsQueued", Napi::Number::New(env, static_cast<double>(progress.rowsQueued)));
+    obj.Set("rowsCompleted", Napi::Number::New(env, static_cast<double>(progress.rowsCompleted)));
+    obj.Set("rowsFailed", Napi::Number::New(env, static_cast<double>(progress.rowsFailed)));
+    obj.Set("bytesRead", Napi::Number::New(env, static_cast<double>(progress.bytesRead)));
+    obj.Set("totalBytes", Napi::Number::New(env, static_cast<double>(progress.totalBytes)));
+    obj.Set("bindMicros", Napi::Number::New(env, NanosToMicros(progress.bindNanos)));
+    obj.Set("runMicros", Napi::Number::New(env, NanosToMicros(progress.runNanos)));
+    obj.Set("parseDone", Napi::Boolean::New(env, progress.parseDone));
+    obj.Set("readFailed", Napi::Boolean::New(env, progress.readFailed));
+    
+    return obj;
+}
+
+Napi::Value FlowBatch::GetCheckpoint(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    
+    BatchCheckpoint checkpoint = engine->checkpoint();
+    
+    Napi::Object obj = Napi::Object::New(env);
+    obj.Set("row", Napi::Number::New(env, static_cast<double>(checkpoint.row)));
+    obj.Set("byteOffset", Napi::Number::New(env, static_cast<double>(checkpoint.offset)));
+    
+    return obj;
+}
+
+Napi::Value FlowBatch::TakeRowTimings(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    
+    std::vector<RowTiming> timings;
+    engine->takeTimings(timings);
+    
+    Napi::Array result = Napi::Array::New(env, timings.size());
+    for (size_t i = 0; i < timings.size(); i++) {
+        Napi::Object obj = Napi::Object::New(env);
+        obj.Set("row", Napi::Number::New(env, static_cast<double>(timings[i].row)));
+        obj.Set("bindMicros", Napi::Number::New(env, NanosToMicros(timings[i].bindNanos)));
+        obj.Set("queueMicros", Napi::Number::New(env, NanosToMicros(timings[i].queueNanos)));
+        obj.Set("runMicros", Napi::Number::New(env, NanosToMicros(timings[i].runNanos)));
+        obj.Set("ok", Napi::Boolean::New(env, timings[i].ok));
+        result[i] = obj;
+    }
+    
+    return result;
+}
+
+Napi::Object InitFlowBatch(Napi::Env env, Napi::Object exports) {
+    return FlowBatch::Init(env, exports);
+}
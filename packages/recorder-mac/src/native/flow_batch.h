@@ -0,0 +1,6 @@
+#pragma once
+
+#include <napi.h>
+
+// Registers the FlowBatch class, the JS face of BatchEngine
+Napi::Object InitFlowBatch(Napi::Env env, Napi::Object exports);
@@ -0,0 +1,258 @@
+#include "flow_runner.h"
+#include "flow_scheduler.h"
+#include "step_broker.h"
+#include <memory>
+
+class FlowRunner : public Napi::ObjectWrap<FlowRunner> {
+public:
+    static Napi::Object Init(Napi::Env env, Napi::Object exports);
+    FlowRunner(const Napi::CallbackInfo& info);
+    ~FlowRunner();
+
+    Napi::Value Submit(const Napi::CallbackInfo& info);
+    Napi::Value TakeSteps(const Napi::CallbackInfo& info);
+    Napi::Value CompleteStep(const Napi::CallbackInfo& info);
+    Napi::Value Cancel(const Napi::CallbackInfo& info);
+    Napi::Value CancelAll(const Napi::CallbackInfo& info);
+    Napi::Value TakeFinished(const Napi::CallbackInfo& info);
+    Napi::Value GetStats(const Napi::CallbackInfo& info);
+    Napi::Value Close(const Napi::CallbackInfo& info);
+
+private:
+    void Shutdown();
+
+    // Declared first so it outlives the scheduler, whose steps it holds
+    std::unique_ptr<StepBroker> broker;
+    std::unique_ptr<FlowScheduler> scheduler;
+    std::vector<StepBroker::Call> calls;
+    // Flows that finished before close(), for the last takeFinished()
+    std::vector<FlowTiming> closedTimings;
+};
+
+Napi::Object FlowRunner::Init(Napi::Env env, Napi::Object exports) {
+    Napi::Function func = DefineClass(env, "FlowRunner", {
+        InstanceMethod("submit", &FlowRunner::Submit),
+        InstanceMethod("takeSteps", &FlowRunner::TakeSteps),
+        InstanceMethod("completeStep", &FlowRunner::CompleteStep),
+        InstanceMethod("cancel", &FlowRunner::Cancel),
+        InstanceMethod("cancelAll", &FlowRunner::CancelAll),
+        InstanceMethod("takeFinished", &FlowRunner::TakeFinished),
+        InstanceMethod("getStats", &FlowRunner::GetStats),
+        InstanceMethod("close", &FlowRunner::Close)
+    });
+
+    exports.Set("FlowRunner", func);
+    return exports;
+}
+
+FlowRunner::FlowRunner(const Napi::CallbackInfo& info) : Napi::ObjectWrap<FlowRunner>(info) {
+    size_t workThreads = 0;
+    uint32_t stepTimeoutMs = 0;
+
+    if (info.Length() > 0 && info[0].IsObject()) {
+        Napi::Object options = info[0].As<Napi::Object>();
+        if (options.Has("workThreads") && options.Get("workThreads").IsNumber()) {
+            workThreads = options.Get("workThreads").As<Napi::Number>().Uint32Value();
+        }
+        if (options.Has("stepTimeoutMs") && options.Get("stepTimeoutMs").IsNumber()) {
+            stepTimeoutMs = options.Get("stepTimeoutMs").As<Napi::Number>().Uint32Value();
+        }
+    }
+
+    broker.reset(new StepBroker());
+    scheduler.reset(new FlowScheduler(workThreads, stepTimeoutMs));
+}
+
+FlowRunner::~FlowRunner() {
+    Shutdown();
+}
+
+void FlowRunner::Shutdown() {
+    if (!scheduler) {
+        return;
+    }
+    // Keep what finished on its own; flows ended by the close are dropped,
+    // and JS rejects their promises instead
+    std::vector<FlowTiming> timings;
+    scheduler->takeFinished(timings);
+    closedTimings.insert(closedTimings.end(), timings.begin(), timings.end());
+
+    // Fail steps JS still holds so every flow can finish
+    scheduler->cancelAll();
+    broker->close();
+    scheduler.reset();
+}
+
+Napi::Value FlowRunner::Submit(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+
+    if (!scheduler) {
+        Napi::Error::New(env, "Flow runner is closed").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    if (info.Length() < 1 || !info[0].IsObject()) {
+        Napi::TypeError::New(env, "Flow object expected").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    Napi::Object source = info[0].As<Napi::Object>();
+    if (!source.Has("steps") || !source.Get("steps").IsArray()) {
+        Napi::TypeError::New(env, "Flow steps array expected").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    FlowSpec spec;
+    if (source.Has("name") && source.Get("name").IsString()) {
+        spec.name = source.Get("name").As<Napi::String>().Utf8Value();
+    }
+
+    StepBroker* stepBroker = broker.get();
+    Napi::Array steps = source.Get("steps").As<Napi::Array>();
+    for (uint32_t i = 0; i < steps.Length(); i++) {
+        ScheduledStep step;
+        if (steps.Get(i).IsObject()) {
+            Napi::Object stepSource = steps.Get(i).As<Napi::Object>();
+            if (stepSource.Has("kind") && stepSource.Get("kind").IsString() &&
+                stepSource.Get("kind").As<Napi::String>().Utf8Value() == "input") {
+                step.kind = StepKind::Input;
+            }
+            if (stepSource.Has("app") && stepSource.Get("app").IsString()) {
+                step.app = stepSource.Get("app").As<Napi::String>().Utf8Value();
+            }
+        }
+        // Every step is executed by JS, so none is native: the scheduler
+        // queues it on the broker inline and never builds its pool
+        step.start = [stepBroker](uint64_t flowId, size_t stepIndex, StepDone done) {
+            stepBroker->call(flowId, stepIndex, std::move(done));
+        };
+        spec.steps.push_back(std::move(step));
+    }
+
+    uint64_t flowId = scheduler->submit(std::move(spec));
+    return Napi::Number::New(env, static_cast<double>(flowId));
+}
+
+Napi::Value FlowRunner::TakeSteps(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+
+    size_t maxSteps = 64;
+    if (info.Length() > 0 && info[0].IsNumber()) {
+        maxSteps = info[0].As<Napi::Number>().Uint32Value();
+    }
+
+    // JS polls here while flows run, which is often enough to time steps out
+    if (scheduler) {
+        scheduler->expireSteps();
+    }
+    size_t count = broker->take(calls, maxSteps);
+
+    Napi::Array result = Napi::Array::New(env, count);
+    for (size_t i = 0; i < count; i++) {
+        Napi::Object obj = Napi::Object::New(env);
+        obj.Set("callId", Napi::Number::New(env, static_cast<double>(calls[i].callId)));
+        obj.Set("flowId", Napi::Number::New(env, static_cast<double>(calls[i].flowId)));
+        obj.Set("stepIndex", Napi::Number::New(env, static_cast<double>(calls[i].stepIndex)));
+        result[i] = obj;
+    }
+
+    return result;
+}
+
+Napi::Value FlowRunner::CompleteStep(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+
+    if (info.Length() < 1 || !info[0].IsNumber()) {
+        Napi::TypeError::New(env, "Call id expected").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    uint64_t callId = static_cast<uint64_t>(info[0].As<Napi::Number>().Int64Value());
+    bool ok = info.Length() < 2 || !info[1].IsBoolean() || info[1].As<Napi::Boolean>().Value();
+
+    return Napi::Boolean::New(env, broker->complete(callId, ok));
+}
+
+Napi::Value FlowRunner::Cancel(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+
+    if (info.Length() < 1 || !info[0].IsNumber()) {
+        Napi::TypeError::New(env, "Flow id expected").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    if (scheduler) {
+        scheduler->cancel(static_cast<uint64_t>(info[0].As<Napi::Number>().Int64Value()));
+    }
+    return Napi::Boolean::New(env, true);
+}
+
+Napi::Value FlowRunner::CancelAll(const Napi::CallbackInfo& info) {
+    if (scheduler) {
+        scheduler->cancelAll();
+    }
+    return Napi::Boolean::New(info.Env(), true);
+}
+
+Napi::Value FlowRunner::TakeFinished(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+
+    std::vector<FlowTiming> timings;
+    if (scheduler) {
+        scheduler->takeFinished(timings);
+    } else {
+        timings.swap(closedTimings);
+    }
+
+    Napi::Array result = Napi::Array::New(env, timings.size());
+    for (size_t i = 0; i < timings.size(); i++) {
+        const FlowTiming& timing = timings[i];
+        Napi::Object obj = Napi::Object::New(env);
+        obj.Set("flowId", Napi::Number::New(env, static_cast<double>(timing.flowId)));
+        obj.Set("name", Napi::String::New(env, timing.name));
+        obj.Set("ok", Napi::Boolean::New(env, timing.ok));
+        obj.Set("cancelled", Napi::Boolean::New(env, timing.cancelled));
+        obj.Set("timedOut", Napi::Boolean::New(env, timing.timedOut));
+        obj.Set("stepsRun", Napi::Number::New(env, static_cast<double>(timing.stepsRun)));
+        obj.Set("queuedMicros", Napi::Number::New(env, static_cast<double>(timing.queuedMicros)));
+        obj.Set("runMicros", Napi::Number::New(env, static_cast<double>(timing.runMicros)));
+        obj.Set("inputMicros", Napi::Number::New(env, static_cast<double>(timing.inputMicros)));
+        obj.Set("workMicros", Napi::Number::New(env, static_cast<double>(timing.workMicros)));
+        result[i] = obj;
+    }
+
+    return result;
+}
+
+Napi::Value FlowRunner::GetStats(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+
+    SchedulerStats stats;
+    if (scheduler) {
+        stats = scheduler->getStats();
+    }
+
+    Napi::Object obj = Napi::Object::New(env);
+    obj.Set("flowsSubmitted", Napi::Number::New(env, static_cast<double>(stats.flowsSubmitted)));
+    obj.Set("flowsFinished", Napi::Number::New(env, static_cast<double>(stats.flowsFinished)));
+    obj.Set("flowsFailed", Napi::Number::New(env, static_cast<double>(stats.flowsFailed)));
+    obj.Set("inputSteps", Napi::Number::New(env, static_cast<double>(stats.inputSteps)));
+    obj.Set("workSteps", Napi::Number::New(env, static_cast<double>(stats.workSteps)));
+    obj.Set("lanes", Napi::Number::New(env, static_cast<double>(stats.lanes)));
+    obj.Set("runningFlows", Napi::Number::New(env, static_cast<double>(stats.runningFlows)));
+    obj.Set("waitingFlows", Napi::Number::New(env, static_cast<double>(stats.waitingFlows)));
+    obj.Set("abandonedFlows", Napi::Number::New(env, static_cast<double>(stats.abandonedFlows)));
+    obj.Set("workThreads", Napi::Number::New(env, static_cast<double>(stats.pool.threads)));
+    obj.Set("workExecuted", Napi::Number::New(env, static_cast<double>(stats.pool.executed)));
+    obj.Set("workSteals", Napi::Number::New(env, static_cast<double>(stats.pool.steals)));
+
+    return obj;
+}
+
+Napi::Value FlowRunner::Close(const Napi::CallbackInfo& info) {
+    Shutdown();
+    return Napi::Boolean::New(info.Env(), true);
+}
+
+Napi::Object InitFlowRunner(Napi::Env env, Napi::Object exports) {
+    return FlowRunner::Init(env, exports);
+}
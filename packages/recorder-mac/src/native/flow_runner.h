@@ -0,0 +1,6 @@
+#pragma once
+
+#include <napi.h>
+
+// Registers the FlowRunner class, the JS face of FlowScheduler
+Napi::Object InitFlowRunner(Napi::Env env, Napi::Object exports);
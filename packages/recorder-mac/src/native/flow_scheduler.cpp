@@ -0,0 +1,328 @@
+#include "flow_scheduler.h"
+#include <algorithm>
+#include <chrono>
+
+namespace {
+
+// Set while a thread is inside advance(). A step that calls done before its
+// start returns re-enters advance(); its flow is queued here instead of
+// recursing once per step.
+struct Dispatch {
+    const void* scheduler;
+    std::vector<uint64_t> ready;
+};
+thread_local Dispatch* currentDispatch = nullptr;
+
+}
+
+FlowScheduler::FlowScheduler(size_t workThreads, uint32_t stepTimeoutMs)
+  : workThreads(workThreads),
+    stepTimeoutMicros(static_cast<long long>(stepTimeoutMs) * 1000),
+    completing(0),
+    nextFlowId(1) {
+}
+
+FlowScheduler::~FlowScheduler() {
+    cancelAll();
+    waitAll();
+    // Pool threads may still be returning from their last start()
+    if (pool) {
+        pool->waitIdle();
+    }
+}
+
+long long FlowScheduler::nowMicros() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+uint64_t FlowScheduler::submit(FlowSpec spec) {
+    uint64_t id;
+    bool admitted;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        id = nextFlowId++;
+
+        std::unique_ptr<Flow> flow(new Flow());
+        flow->id = id;
+        flow->spec = std::move(spec);
+        flow->submittedAt = nowMicros();
+
+        for (const ScheduledStep& step : flow->spec.steps) {
+            if (step.kind == StepKind::Input) {
+                flow->apps.push_back(step.app);
+            }
+        }
+        std::sort(flow->apps.begin(), flow->apps.end());
+        flow->apps.erase(std::unique(flow->apps.begin(), flow->apps.end()), flow->apps.end());
+
+        for (const std::string& app : flow->apps) {
+            lanes[app].waiting.push_back(id);
+        }
+
+        admitted = tryAdmit(*flow);
+        flows[id] = std::move(flow);
+        stats.flowsSubmitted++;
+    }
+
+    if (admitted) {
+        advance({id});
+    }
+    return id;
+}
+
+bool FlowScheduler::tryAdmit(Flow& flow) {
+    for (const std::string& app : flow.apps) {
+        if (lanes[app].waiting.front() != flow.id) {
+            return false;
+        }
+    }
+    flow.admitted = true;
+    flow.admittedAt = nowMicros();
+    return true;
+}
+
+void FlowScheduler::advance(std::vector<uint64_t> ready) {
+    if (currentDispatch && currentDispatch->scheduler == this) {
+        currentDispatch->ready.insert(currentDispatch->ready.end(), ready.begin(), ready.end());
+        return;
+    }
+
+    Dispatch dispatch{this, std::move(ready)};
+    Dispatch* outer = currentDispatch;
+    currentDispatch = &dispatch;
+
+    while (!dispatch.ready.empty()) {
+        uint64_t id = dispatch.ready.back();
+        dispatch.ready.pop_back();
+
+        const ScheduledStep* step = nullptr;
+        size_t index = 0;
+        WorkStealingPool* workPool = nullptr;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto it = flows.find(id);
+            if (it == flows.end()) {
+                continue;
+            }
+
+            Flow& flow = *it->second;
+            if (flow.cancelled || !flow.ok || flow.nextStep >= flow.spec.steps.size()) {
+                finish(flow, dispatch.ready);
+                continue;
+            }
+
+            // The flow is only erased by finish(), which runs after its
+            // running step is done, so the step outlives the start below
+            index = flow.nextStep;
+            step = &flow.spec.steps[index];
+            flow.stepRunning = true;
+            flow.stepStartedAt = nowMicros();
+
+            if (step->kind == StepKind::Work && step->native) {
+                if (!pool) {
+                    pool.reset(new WorkStealingPool(workThreads));
+                }
+                workPool = pool.get();
+            }
+        }
+
+        // The flow already holds its lanes, so a step that only hands itself
+        // off needs no thread of its own; native work computes in place
+        if (workPool) {
+            workPool->submit([this, id, index, step] { start(id, index, step); });
+        } else {
+            start(id, index, step);
+        }
+    }
+
+    currentDispatch = outer;
+}
+
+void FlowScheduler::start(uint64_t flowId, size_t stepIndex, const ScheduledStep* step) {
+    StepKind kind = step->kind;
+    long long startedAt = nowMicros();
+    if (!step->start) {
+        complete(flowId, kind, startedAt, true);
+        return;
+    }
+
+    try {
+        step->start(flowId, stepIndex, [this, flowId, kind, startedAt](bool ok) {
+            complete(flowId, kind, startedAt, ok);
+        });
+    } catch (...) {
+        complete(flowId, kind, startedAt, false);
+    }
+}
+
+void FlowScheduler::complete(uint64_t flowId, StepKind kind, long long startedAt, bool ok) {
+    uint64_t elapsed = static_cast<uint64_t>(nowMicros() - startedAt);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = flows.find(flowId);
+        if (it == flows.end() || !it->second->stepRunning) {
+            return; // Reported twice
+        }
+
+        Flow& flow = *it->second;
+        if (kind == StepKind::Input) {
+            flow.inputMicros += elapsed;
+            stats.inputSteps++;
+        } else {
+            flow.workMicros += elapsed;
+            stats.workSteps++;
+        }
+        flow.ok = flow.ok && ok;
+        flow.stepRunning = false;
+        flow.nextStep++;
+        completing++;
+    }
+
+    advance({flowId});
+
+    // Last touch of the scheduler: waitAll() can return once this unlocks
+    std::lock_guard<std::mutex> lock(mutex);
+    completing--;
+    flowFinished.notify_all();
+}
+
+void FlowScheduler::report(Flow& flow, long long now) {
+    FlowTiming timing;
+    timing.flowId = flow.id;
+    timing.name = flow.spec.name;
+    timing.cancelled = flow.cancelled;
+    timing.timedOut = flow.timedOut;
+    timing.ok = flow.ok && !flow.cancelled;
+    timing.stepsRun = flow.nextStep;
+    timing.queuedMicros = static_cast<uint64_t>((flow.admitted ? flow.admittedAt : now) - flow.submittedAt);
+    timing.runMicros = flow.admitted ? static_cast<uint64_t>(now - flow.admittedAt) : 0;
+    timing.inputMicros = flow.inputMicros;
+    timing.workMicros = flow.workMicros;
+
+    stats.flowsFinished++;
+    if (!timing.ok) {
+        stats.flowsFailed++;
+    }
+    unreported.push_back(std::move(timing));
+    flow.reported = true;
+}
+
+void FlowScheduler::finish(Flow& flow, std::vector<uint64_t>& admitted) {
+    if (!flow.reported) {
+        report(flow, nowMicros());
+    }
+
+    // Release the lanes; a cancelled flow may still be waiting mid-queue
+    std::vector<Lane*> released;
+    for (const std::string& app : flow.apps) {
+        Lane& lane = lanes[app];
+        auto it = std::find(lane.waiting.begin(), lane.waiting.end(), flow.id);
+        if (it != lane.waiting.end()) {
+            lane.waiting.erase(it);
+            released.push_back(&lane);
+        }
+    }
+
+    flows.erase(flow.id);
+
+    for (Lane* lane : released) {
+        if (lane->waiting.empty()) {
+            continue;
+        }
+        Flow& next = *flows[lane->waiting.front()];
+        if (!next.admitted && tryAdmit(next)) {
+            admitted.push_back(next.id);
+        }
+    }
+
+    flowFinished.notify_all();
+}
+
+void FlowScheduler::cancel(uint64_t flowId) {
+    std::vector<uint64_t> admitted;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = flows.find(flowId);
+        if (it == flows.end()) {
+            return;
+        }
+
+        Flow& flow = *it->second;
+        flow.cancelled = true;
+        // A running flow stops at its next step; a waiting one ends now
+        if (!flow.admitted) {
+            finish(flow, admitted);
+        }
+    }
+    advance(std::move(admitted));
+}
+
+void FlowScheduler::cancelAll() {
+    std::vector<uint64_t> ids;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (const auto& entry : flows) {
+            ids.push_back(entry.first);
+        }
+    }
+    for (uint64_t id : ids) {
+        cancel(id);
+    }
+}
+
+size_t FlowScheduler::expireSteps() {
+    if (stepTimeoutMicros <= 0) {
+        return 0;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    long long now = nowMicros();
+    size_t expired = 0;
+    for (const auto& entry : flows) {
+        Flow& flow = *entry.second;
+        if (!flow.stepRunning || flow.reported || now - flow.stepStartedAt < stepTimeoutMicros) {
+            continue;
+        }
+        flow.ok = false;
+        flow.timedOut = true;
+        report(flow, now);
+        expired++;
+    }
+    return expired;
+}
+
+void FlowScheduler::waitAll() {
+    std::unique_lock<std::mutex> lock(mutex);
+    flowFinished.wait(lock, [this] { return flows.empty() && completing == 0; });
+}
+
+size_t FlowScheduler::takeFinished(std::vector<FlowTiming>& out) {
+    std::lock_guard<std::mutex> lock(mutex);
+    out.assign(unreported.begin(), unreported.end());
+    unreported.clear();
+    return out.size();
+}
+
+SchedulerStats FlowScheduler::getStats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    SchedulerStats result = stats;
+    result.lanes = lanes.size();
+    result.runningFlows = 0;
+    result.waitingFlows = 0;
+    result.abandonedFlows = 0;
+    for (const auto& entry : flows) {
+        const Flow& flow = *entry.second;
+        if (flow.reported) {
+            result.abandonedFlows++;
+        } else if (flow.admitted) {
+            result.runningFlows++;
+        } else {
+            result.waitingFlows++;
+        }
+    }
+    if (pool) {
+        result.pool = pool->getStats();
+    }
+    return result;
+}
@@ -0,0 +1,152 @@
+#pragma once
+
+// Runs independent flows concurrently. Steps of one flow stay sequential.
+// A flow holds a lane per target application from admission to completion,
+// so UI input into an app is never interleaved between flows; lanes are
+// granted in submission order, which keeps flows that span several apps
+// free of deadlock. Steps are asynchronous: a step is started and reports
+// back through its completion callback, so no scheduler thread waits on a
+// step running elsewhere. Native work steps, whose start computes in place,
+// run on a WorkStealingPool created for the first of them; every other step
+// only hands itself off and is started on the thread that advanced the flow.
+
+#include "work_stealing_pool.h"
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+enum class StepKind { Input, Work };
+
+// Reports a step's outcome; false fails the flow. Call exactly once, from
+// any thread.
+using StepDone = std::function<void(bool ok)>;
+
+struct ScheduledStep {
+    StepKind kind = StepKind::Work;
+    std::string app; // Lane for input steps
+    // A work step whose start does the work itself rather than handing it
+    // off (e.g. to JS); only these are worth a pool thread
+    bool native = false;
+    // Called with the flow id and step index. Either finishes the step and
+    // calls `done` before returning, or hands it off and calls `done` later.
+    // A start that throws fails the step and must not also call `done`.
+    // An empty start succeeds at once.
+    std::function<void(uint64_t, size_t, StepDone)> start;
+};
+
+struct FlowSpec {
+    std::string name;
+    std::vector<ScheduledStep> steps;
+};
+
+struct FlowTiming {
+    uint64_t flowId = 0;
+    std::string name;
+    bool ok = true;
+    bool cancelled = false;
+    bool timedOut = false;
+    size_t stepsRun = 0;
+    uint64_t queuedMicros = 0; // Submitted until its lanes were granted
+    uint64_t runMicros = 0;    // Granted until the last step finished
+    uint64_t inputMicros = 0;  // Started until done, input steps
+    uint64_t workMicros = 0;   // Started until done, work steps
+};
+
+struct SchedulerStats {
+    uint64_t flowsSubmitted = 0;
+    uint64_t flowsFinished = 0;
+    uint64_t flowsFailed = 0;
+    uint64_t inputSteps = 0;
+    uint64_t workSteps = 0;
+    size_t lanes = 0;
+    size_t runningFlows = 0;
+    size_t waitingFlows = 0;
+    // Timed out and reported, but still holding lanes until the step is done
+    size_t abandonedFlows = 0;
+    WorkPoolStats pool; // All zero until a native work step has run
+};
+
+class FlowScheduler {
+public:
+    // workThreads sizes the pool for native work steps (0 = one per hardware
+    // thread); no thread starts until the first such step. A step running
+    // longer than stepTimeoutMs (0 = never) fails its flow when expireSteps()
+    // runs.
+    explicit FlowScheduler(size_t workThreads = 0, uint32_t stepTimeoutMs = 0);
+    // Cancels flows that have not finished and waits for running steps
+    ~FlowScheduler();
+
+    uint64_t submit(FlowSpec spec);
+    // Remaining steps are skipped; a step already running finishes first
+    void cancel(uint64_t flowId);
+    void cancelAll();
+
+    // There is no timer thread; callers poll this. A timed-out flow is
+    // reported as failed at once, but keeps its lanes until its running step
+    // calls done, so nothing else can drive the app underneath it. Returns
+    // the number of flows that timed out.
+    size_t expireSteps();
+
+    // Blocks until every submitted flow has finished
+    void waitAll();
+
+    // Moves out timings of flows that finished since the last call
+    size_t takeFinished(std::vector<FlowTiming>& out);
+    SchedulerStats getStats() const;
+
+private:
+    struct Flow {
+        uint64_t id;
+        FlowSpec spec;
+        std::vector<std::string> apps;
+        size_t nextStep = 0;
+        bool admitted = false;
+        bool cancelled = false;
+        bool ok = true;
+        bool stepRunning = false;
+        bool timedOut = false;
+        bool reported = false; // Timing already in `unreported`
+        long long submittedAt = 0;
+        long long admittedAt = 0;
+        long long stepStartedAt = 0;
+        uint64_t inputMicros = 0;
+        uint64_t workMicros = 0;
+    };
+
+    // Exclusive right to send input to one application
+    struct Lane {
+        std::deque<uint64_t> waiting; // Front holds the lane
+    };
+
+    bool tryAdmit(Flow& flow);
+    // Starts the next step of each ready flow, finishing any that are done
+    void advance(std::vector<uint64_t> ready);
+    void start(uint64_t flowId, size_t stepIndex, const ScheduledStep* step);
+    void complete(uint64_t flowId, StepKind kind, long long startedAt, bool ok);
+    void report(Flow& flow, long long now);
+    void finish(Flow& flow, std::vector<uint64_t>& admitted);
+    static long long nowMicros();
+
+    const size_t workThreads;
+    const long long stepTimeoutMicros;
+
+    mutable std::mutex mutex;
+    std::condition_variable flowFinished;
+    std::map<uint64_t, std::unique_ptr<Flow>> flows;
+    std::map<std::string, Lane> lanes;
+    std::deque<FlowTiming> unreported;
+    // complete() calls that may still touch the scheduler; waitAll() waits
+    // for them so the destructor cannot run underneath one
+    size_t completing;
+    uint64_t nextFlowId;
+    SchedulerStats stats;
+    // Created under `mutex` and never replaced, so a pointer read under it
+    // stays valid
+    std::unique_ptr<WorkStealingPool> pool;
+};
@@ -0,0 +1,95 @@
+#include "flow_template.h"
+
+namespace {
+
+std::string trim(const std::string& value) {
+    size_t first = value.find_first_not_of(" \t");
+    if (first == std::string::npos) {
+        return std::string();
+    }
+    size_t last = value.find_last_not_of(" \t");
+    return value.substr(first, last - first + 1);
+}
+
+}
+
+bool FlowTemplate::compile(const std::string& source, const TemplateScope& scope, std::string& error) {
+    literals.clear();
+    segments.clear();
+    constant = true;
+
+    auto addLiteral = [this](const std::string& text, size_t from, size_t to) {
+        if (to <= from) {
+            return;
+        }
+        // Merge with a preceding literal so render does one append per run
+        if (!segments.empty() && !segments.back().column) {
+            segments.back().length += static_cast<uint32_t>(to - from);
+        } else {
+            segments.push_back({false, static_cast<uint32_t>(literals.size()),
+                                static_cast<uint32_t>(to - from)});
+        }
+        literals.append(text, from, to - from);
+    };
+
+    size_t cursor = 0;
+    while (cursor < source.size()) {
+        size_t open = source.find("{{", cursor);
+        if (open == std::string::npos) {
+            break;
+        }
+        size_t close = source.find("}}", open + 2);
+        if (close == std::string::npos) {
+            error = "Unterminated placeholder at offset " + std::to_string(open);
+            return false;
+        }
+
+        addLiteral(source, cursor, open);
+        cursor = close + 2;
+
+        std::string name = trim(source.substr(open + 2, close - open - 2));
+        if (name.empty()) {
+            error = "Empty placeholder at offset " + std::to_string(open);
+            return false;
+        }
+
+        size_t dot = name.find('.');
+        if (dot != std::string::npos) {
+            std::string prefix = name.substr(0, dot);
+            std::string column = name.substr(dot + 1);
+            bool knownPrefix = false;
+            for (const std::string& candidate : scope.rowPrefixes) {
+                knownPrefix = knownPrefix || candidate == prefix;
+            }
+
+            auto it = scope.columns.find(column);
+            if (!knownPrefix || it == scope.columns.end()) {
+                error = "Unknown column in {{" + name + "}}";
+                return false;
+            }
+            segments.push_back({true, it->second, 0});
+            constant = false;
+            continue;
+        }
+
+        auto it = scope.variables.find(name);
+        if (it == scope.variables.end()) {
+            error = "Unknown variable {{" + name + "}}";
+            return false;
+        }
+        addLiteral(it->second, 0, it->second.size());
+    }
+
+    addLiteral(source, cursor, source.size());
+    return true;
+}
+
+void FlowTemplate::render(const std::vector<std::string_view>& row, std::string& out) const {
+    for (const Segment& segment : segments) {
+        if (!segment.column) {
+            out.append(literals.data() + segment.index, segment.length);
+        } else if (segment.index < row.size()) {
+            out.append(row[segment.index].data(), row[segment.index].size());
+        }
+    }
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+// `{{name}}` / `{{row.column}}` substitution for FlowStep text, selector and
+// url. A template is compiled once per flow against the table header; scalar
+// variables are folded into the literals, so binding a row is a short
+// sequence of appends.
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Names a template may reference
+struct TemplateScope {
+    // Loop variable and table variable names that prefix column references
+    std::vector<std::string> rowPrefixes;
+    std::unordered_map<std::string, uint32_t> columns;
+    std::unordered_map<std::string, std::string> variables;
+};
+
+class FlowTemplate {
+public:
+    // Returns false and describes the first unknown or malformed placeholder
+    bool compile(const std::string& source, const TemplateScope& scope, std::string& error);
+
+    // Appends to `out`; missing trailing columns render as empty
+    void render(const std::vector<std::string_view>& row, std::string& out) const;
+
+    // True when the template does not depend on the row
+    bool isConstant() const { return constant; }
+
+private:
+    struct Segment {
+        bool column;
+        uint32_t index;  // Column index, or offset into literals
+        uint32_t length; // Literal length
+    };
+
+    std::string literals;
+    std::vector<Segment> segments;
+    bool constant = true;
+};
@@ -0,0 +1,204 @@
+#include "hover_prefetcher.h"
+#include "ax_element.h"
+#include <pthread.h>
+#include <algorithm>
+#include <chrono>
+
+HoverPrefetcher::HoverPrefetcher() :
+    running(false),
+    stopRequested(false),
+    cursorX(0),
+    cursorY(0),
+    lastMoveAt(0),
+    lastPrefetched({-1, -1}),
+    prefetches(0),
+    hits(0),
+    misses(0),
+    staleHits(0),
+    hitLatencyMicros(0),
+    missLatencyMicros(0),
+    savedMicros(0) {}
+
+HoverPrefetcher::~HoverPrefetcher() {
+    stop();
+}
+
+void HoverPrefetcher::start() {
+    if (running) {
+        return;
+    }
+    
+    stopRequested = false;
+    lastMoveAt = 0;
+    running = true;
+    worker = std::thread(&HoverPrefetcher::run, this);
+}
+
+void HoverPrefetcher::stop() {
+    if (!running) {
+        return;
+    }
+    
+    {
+        std::lock_guard<std::mutex> lock(cacheMutex);
+        stopRequested = true;
+    }
+    wake.notify_all();
+    worker.join();
+    running = false;
+    
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    entries.clear();
+    lastPrefetched = {-1, -1};
+}
+
+void HoverPrefetcher::onMouseMoved(CGPoint location) {
+    cursorX = static_cast<long long>(location.x);
+    cursorY = static_cast<long long>(location.y);
+    lastMoveAt = nowMicros();
+}
+
+bool HoverPrefetcher::lookup(CGPoint location, AXUIElementRef element, TargetDescriptor& descriptor) {
+    if (!running) {
+        return false;
+    }
+    
+    std::unique_lock<std::mutex> lock(cacheMutex);
+    long long now = nowMicros();
+    
+    bool stale = false;
+    for (const Entry& entry : entries) {
+        if (now - entry.resolvedAt > kEntryTtlMicros || !contains(entry.descriptor.frame, location)) {
+            continue;
+        }
+        // A frame containing the point is not enough: it may be a container of
+        // the clicked element, or content that has since scrolled or changed
+        if (!entry.element.matches(element)) {
+            stale = true;
+            continue;
+        }
+        
+        descriptor = entry.descriptor;
+        hits++;
+        savedMicros += entry.resolveMicros;
+        lock.unlock();
+        
+        // Typing changes the value without a scroll or a new element
+        descriptor.value = AXElementInfo::getStringAttributeForElement(element, kAXValueAttribute);
+        return true;
+    }
+    
+    if (stale) {
+        staleHits++;
+    }
+    misses++;
+    return false;
+}
+
+void HoverPrefetcher::invalidate() {
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    entries.clear();
+    lastPrefetched = {-1, -1};
+}
+
+void HoverPrefetcher::recordLatency(bool hit, uint64_t micros) {
+    if (hit) {
+        hitLatencyMicros += micros;
+    } else {
+        missLatencyMicros += micros;
+    }
+}
+
+PrefetchStats HoverPrefetcher::getStats() const {
+    PrefetchStats stats;
+    stats.prefetches = prefetches.load();
+    stats.hits = hits.load();
+    stats.misses = misses.load();
+    stats.staleHits = staleHits.load();
+    stats.hitLatencyMicros = hitLatencyMicros.load();
+    stats.missLatencyMicros = missLatencyMicros.load();
+    stats.savedMicros = savedMicros.load();
+    return stats;
+}
+
+void HoverPrefetcher::run() {
+    pthread_set_qos_class_self_np(QOS_CLASS_USER_INITIATED, 0);
+    
+    std::unique_lock<std::mutex> lock(cacheMutex);
+    while (!stopRequested) {
+        wake.wait_for(lock, std::chrono::microseconds(kDwellMicros / 2));
+        if (stopRequested) {
+            break;
+        }
+        
+        long long movedAt = lastMoveAt;
+        if (movedAt == 0 || nowMicros() - movedAt < kDwellMicros) {
+            continue;
+        }
+        
+        CGPoint cursor = {static_cast<CGFloat>(cursorX.load()), static_cast<CGFloat>(cursorY.load())};
+        if (cursor.x == lastPrefetched.x && cursor.y == lastPrefetched.y) {
+            continue;
+        }
+        lastPrefetched = cursor;
+        
+        lock.unlock();
+        prefetch(cursor);
+        lock.lock();
+    }
+}
+
+void HoverPrefetcher::prefetch(CGPoint location) {
+    AXUIElementRef atPoint = AXElementInfo::getElementAtPoint(location);
+    if (!atPoint) {
+        return;
+    }
+    
+    Entry entry;
+    entry.element = AXElementHandle(atPoint);
+    CFRelease(atPoint);
+    
+    // A hit still queries the element at the click point; what it skips is
+    // reading the descriptor attributes
+    long long startedAt = nowMicros();
+    AXElementInfo elementInfo;
+    elementInfo.setElement(entry.element.get());
+    elementInfo.describe(entry.descriptor);
+    entry.resolvedAt = nowMicros();
+    entry.resolveMicros = static_cast<uint64_t>(entry.resolvedAt - startedAt);
+    
+    const Frame& frame = entry.descriptor.frame;
+    if (frame.width <= 0 || frame.height <= 0) {
+        return;
+    }
+    
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    entries.erase(
+        std::remove_if(entries.begin(), entries.end(),
+            [&entry](const Entry& e) {
+                return e.element.matches(entry.element.get()) || sameTarget(e.descriptor, entry.descriptor);
+            }),
+        entries.end());
+    entries.push_front(entry);
+    if (entries.size() > kCapacity) {
+        entries.pop_back();
+    }
+    prefetches++;
+}
+
+bool HoverPrefetcher::contains(const Frame& frame, CGPoint point) {
+    return point.x >= frame.x && point.y >= frame.y &&
+           point.x < frame.x + frame.width && point.y < frame.y + frame.height;
+}
+
+bool HoverPrefetcher::sameTarget(const TargetDescriptor& a, const TargetDescriptor& b) {
+    return a.role == b.role && a.title == b.title && a.identifier == b.identifier &&
+           a.frame.x == b.frame.x && a.frame.y == b.frame.y &&
+           a.frame.width == b.frame.width && a.frame.height == b.frame.height;
+}
+
+long long HoverPrefetcher::nowMicros() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()
+    ).count();
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include "ax_element.h"
+#include "event_monitor.h"
+#include <ApplicationServices/ApplicationServices.h>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+// Resolves the element under a resting cursor ahead of the click. The click
+// path still asks AX for the element at the point, but when that is an element
+// resolved during the dwell it reuses the cached descriptor instead of reading
+// every attribute again. The value is the one attribute typing changes without
+// moving anything, so a hit reads it afresh.
+class HoverPrefetcher {
+public:
+    HoverPrefetcher();
+    ~HoverPrefetcher();
+
+    void start();
+    void stop();
+
+    // Called from the tap thread; lock-free
+    void onMouseMoved(CGPoint location);
+
+    // Fills the descriptor and returns true if a fresh entry holds `element`,
+    // the element currently at `location`, and its frame contains the point.
+    // The value is re-read from `element` outside the cache lock.
+    bool lookup(CGPoint location, AXUIElementRef element, TargetDescriptor& descriptor);
+
+    // Drops every entry; called when content under the cursor scrolled or an
+    // observed app reported a layout change
+    void invalidate();
+
+    void recordLatency(bool hit, uint64_t micros);
+    PrefetchStats getStats() const;
+
+private:
+    struct Entry {
+        AXElementHandle element;
+        TargetDescriptor descriptor;
+        long long resolvedAt;
+        uint64_t resolveMicros;
+    };
+
+    void run();
+    void prefetch(CGPoint location);
+    static bool contains(const Frame& frame, CGPoint point);
+    static bool sameTarget(const TargetDescriptor& a, const TargetDescriptor& b);
+    static long long nowMicros();
+
+    static constexpr long long kDwellMicros = 120 * 1000;
+    static constexpr long long kEntryTtlMicros = 2000 * 1000;
+    static constexpr size_t kCapacity = 8;
+
+    std::thread worker;
+    std::atomic<bool> running;
+    std::atomic<bool> stopRequested;
+
+    // Latest cursor sample, published by the tap thread
+    std::atomic<long long> cursorX;
+    std::atomic<long long> cursorY;
+    std::atomic<long long> lastMoveAt;
+
+    mutable std::mutex cacheMutex;
+    std::condition_variable wake;
+    std::deque<Entry> entries;
+    CGPoint lastPrefetched;
+
+    std::atomic<uint64_t> prefetches;
+    std::atomic<uint64_t> hits;
+    std::atomic<uint64_t> misses;
+    std::atomic<uint64_t> staleHits;
+    std::atomic<uint64_t> hitLatencyMicros;
+    std::atomic<uint64_t> missLatencyMicros;
+    std::atomic<uint64_t> savedMicros;
+};
@@ -0,0 +1,145 @@
+// Standalone process that runs the EventMonitor pipeline on behalf of the
+// addon and streams encoded steps into the shared-memory ring whose descriptor
+// it inherited.
+// Commands arrive one per line on stdin; replies go to the reply descriptor.
+
+#include "event_monitor.h"
+#include "hover_prefetcher.h"
+#include "recorder_helper_client.h"
+#include "step_codec.h"
+#include "step_ring.h"
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <poll.h>
+#include <string>
+#include <unistd.h>
+
+namespace {
+
+const int kCounterPublishIntervalMs = 500;
+
+void publishCounters(EventMonitor* monitor, StepRing& ring) {
+    TapStats tap = monitor->getTapStats();
+    ring.setCounter(kHelperTapTimeoutRecoveries, tap.timeoutRecoveries);
+    ring.setCounter(kHelperTapUserInputRecoveries, tap.userInputRecoveries);
+    ring.setCounter(kHelperTapLastRecoveryAt, static_cast<uint64_t>(tap.lastRecoveryAt));
+    
+    PrefetchStats prefetch = monitor->getPrefetchStats();
+    ring.setCounter(kHelperPrefetches, prefetch.prefetches);
+    ring.setCounter(kHelperPrefetchHits, prefetch.hits);
+    ring.setCounter(kHelperPrefetchMisses, prefetch.misses);
+    ring.setCounter(kHelperPrefetchStaleHits, prefetch.staleHits);
+    ring.setCounter(kHelperPrefetchHitLatencyMicros, prefetch.hitLatencyMicros);
+    ring.setCounter(kHelperPrefetchMissLatencyMicros, prefetch.missLatencyMicros);
+    ring.setCounter(kHelperPrefetchSavedMicros, prefetch.savedMicros);
+    
+    ElementIndexStats index = monitor->getIndexStats();
+    ring.setCounter(kHelperIndexHits, index.hits);
+    ring.setCounter(kHelperIndexMisses, index.misses);
+    ring.setCounter(kHelperIndexStaleMisses, index.staleMisses);
+    ring.setCounter(kHelperIndexInserts, index.inserts);
+    ring.setCounter(kHelperIndexWindowMoves, index.windowMoves);
+    ring.setCounter(kHelperIndexWindowResets, index.windowResets);
+    ring.setCounter(kHelperIndexEvictions, index.evictions);
+    ring.setCounter(kHelperIndexElements, index.elements);
+    ring.setCounter(kHelperIndexWindows, index.windows);
+}
+
+void reply(int fd, bool ok) {
+    const char* line = ok ? "ok\n" : "error\n";
+    ssize_t written = write(fd, line, strlen(line));
+    (void)written;
+}
+
+}
+
+int main(int argc, char** argv) {
+    int ringFd = -1;
+    int wakeFd = -1;
+    int replyFd = -1;
+    EventFilter filter;
+    
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string flag = argv[i];
+        std::string value = argv[i + 1];
+        
+        if (flag == "--ring-fd") {
+            ringFd = std::atoi(value.c_str());
+        } else if (flag == "--wake-fd") {
+            wakeFd = std::atoi(value.c_str());
+        } else if (flag == "--reply-fd") {
+            replyFd = std::atoi(value.c_str());
+        } else if (flag == "--actions") {
+            filter.actionMask = static_cast<uint32_t>(std::strtoul(value.c_str(), nullptr, 10));
+        } else if (flag == "--app") {
+            filter.appName = value;
+        } else if (flag == "--pid") {
+            filter.processId = std::atoi(value.c_str());
+        } else if (flag == "--role") {
+            filter.roles.push_back(value);
+        } else if (flag == "--region") {
+            Frame& r = filter.region;
+            filter.hasRegion = sscanf(value.c_str(), "%d,%d,%d,%d", &r.x, &r.y, &r.width, &r.height) == 4;
+        }
+    }
+    
+    std::unique_ptr<StepRing> ring = StepRing::fromFd(ringFd);
+    if (!ring || wakeFd < 0 || replyFd < 0) {
+        std::cerr << "ax_recorder_helper: invalid arguments or ring descriptor " << ringFd << std::endl;
+        return 1;
+    }
+    std::unique_ptr<WakeChannel> wake = WakeChannel::fromFd(wakeFd);
+    
+    EventMonitor* monitor = EventMonitor::getInstance();
+    SubscriptionId subscription = monitor->subscribe(filter, [&ring, &wake](const RecordedStep& step) {
+        // Runs on the tap thread; reuse one buffer instead of allocating per step
+        static thread_local std::string buffer;
+        encodeStep(step, buffer);
+        ring->push(buffer.data(), buffer.size(), wake.get());
+    });
+    
+    std::string pending;
+    bool running = true;
+    
+    while (running) {
+        struct pollfd pfd = {STDIN_FILENO, POLLIN, 0};
+        int ready = poll(&pfd, 1, kCounterPublishIntervalMs);
+        publishCounters(monitor, *ring);
+        if (ready <= 0) {
+            continue;
+        }
+        
+        char buffer[256];
+        ssize_t received = read(STDIN_FILENO, buffer, sizeof(buffer));
+        if (received <= 0) {
+            // The addon closed the pipe or went away
+            break;
+        }
+        pending.append(buffer, static_cast<size_t>(received));
+        
+        size_t newline;
+        while ((newline = pending.find('\n')) != std::string::npos) {
+            std::string command = pending.substr(0, newline);
+            pending.erase(0, newline + 1);
+            
+            if (command.compare(0, 6, "start ") == 0) {
+                reply(replyFd, monitor->startRecording(subscription, command.substr(6)));
+            } else if (command == "stop") {
+                monitor->stopRecording(subscription);
+                reply(replyFd, true);
+            } else if (command == "quit") {
+                reply(replyFd, true);
+                running = false;
+                break;
+            } else {
+                reply(replyFd, false);
+            }
+        }
+    }
+    
+    monitor->stopRecording(subscription);
+    monitor->unsubscribe(subscription);
+    publishCounters(monitor, *ring);
+    return 0;
+}
@@ -0,0 +1,328 @@
+#include "recorder_helper_client.h"
+#include "step_codec.h"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <fcntl.h>
+#include <iostream>
+#include <poll.h>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+extern char** environ;
+
+namespace {
+
+// Descriptor numbers the helper sees; stdin carries commands
+const int kHelperWakeFd = 3;
+const int kHelperReplyFd = 4;
+const int kHelperRingFd = 5;
+
+const size_t kRingCapacity = 4 * 1024 * 1024;
+const int kReplyTimeoutMs = 5000;
+
+std::string nextRingName() {
+    // macOS limits shared memory names to 31 characters
+    static std::atomic<unsigned> counter(0);
+    return "/axrec-" + std::to_string(getpid()) + "-" + std::to_string(counter++);
+}
+
+}
+
+RecorderHelperClient::RecorderHelperClient(const std::string& helperPath, const EventFilter& filter, StepCallback callback) :
+    callback(callback),
+    helperPid(-1),
+    commandFd(-1),
+    replyFd(-1),
+    stopRequested(false),
+    alive(false),
+    exited(false),
+    recording(false) {
+    if (!spawn(helperPath, filter)) {
+        std::cerr << "Failed to start recorder helper: " << helperPath << std::endl;
+        return;
+    }
+    
+    alive = true;
+    consumer = std::thread(&RecorderHelperClient::consume, this);
+}
+
+RecorderHelperClient::~RecorderHelperClient() {
+    stopRequested = true;
+    
+    if (commandFd >= 0) {
+        // EOF on its command pipe tells the helper to shut down
+        close(commandFd);
+        commandFd = -1;
+    }
+    
+    if (consumer.joinable()) {
+        consumer.join();
+    }
+    
+    if (helperPid > 0 && !exited) {
+        int status;
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+        while (waitpid(helperPid, &status, WNOHANG) == 0) {
+            if (std::chrono::steady_clock::now() > deadline) {
+                kill(helperPid, SIGKILL);
+                waitpid(helperPid, &status, 0);
+                break;
+            }
+            usleep(10 * 1000);
+        }
+    }
+    
+    if (replyFd >= 0) {
+        close(replyFd);
+    }
+}
+
+bool RecorderHelperClient::spawn(const std::string& helperPath, const EventFilter& filter) {
+    ring = StepRing::create(nextRingName(), kRingCapacity);
+    wake = WakeChannel::create();
+    if (!ring || !wake) {
+        return false;
+    }
+    
+    int commandPipe[2];
+    int replyPipe[2];
+    if (pipe(commandPipe) != 0) {
+        return false;
+    }
+    if (pipe(replyPipe) != 0) {
+        close(commandPipe[0]);
+        close(commandPipe[1]);
+        return false;
+    }
+    for (int fd : {commandPipe[0], commandPipe[1], replyPipe[0], replyPipe[1]}) {
+        fcntl(fd, F_SETFD, FD_CLOEXEC);
+    }
+    // Our ends never block: a command is one short line, and replies are
+    // read only when poll() says they are there
+    fcntl(commandPipe[1], F_SETFL, O_NONBLOCK);
+    fcntl(replyPipe[0], F_SETFL, O_NONBLOCK);
+    
+    std::vector<std::string> args = {
+        helperPath,
+        "--ring-fd", std::to_string(kHelperRingFd),
+        "--wake-fd", std::to_string(kHelperWakeFd),
+        "--reply-fd", std::to_string(kHelperReplyFd),
+        "--actions", std::to_string(filter.actionMask)
+    };
+    if (!filter.appName.empty()) {
+        args.insert(args.end(), {"--app", filter.appName});
+    }
+    if (filter.processId != 0) {
+        args.insert(args.end(), {"--pid", std::to_string(filter.processId)});
+    }
+    for (const std::string& role : filter.roles) {
+        args.insert(args.end(), {"--role", role});
+    }
+    if (filter.hasRegion) {
+        args.insert(args.end(), {"--region",
+            std::to_string(filter.region.x) + "," + std::to_string(filter.region.y) + "," +
+            std::to_string(filter.region.width) + "," + std::to_string(filter.region.height)});
+    }
+    
+    std::vector<char*> argv;
+    for (std::string& arg : args) {
+        argv.push_back(&arg[0]);
+    }
+    argv.push_back(nullptr);
+    
+    // Hand the helper copies numbered above every target: a source that is
+    // itself 3-5 would otherwise be overwritten by an earlier dup2, or keep
+    // its close-on-exec flag when dup2'd onto itself
+    const int sources[] = {commandPipe[0], wake->writeFd(), replyPipe[1], ring->descriptor()};
+    const int targets[] = {STDIN_FILENO, kHelperWakeFd, kHelperReplyFd, kHelperRingFd};
+    int copies[4];
+    bool copied = true;
+    for (int i = 0; i < 4; i++) {
+        copies[i] = fcntl(sources[i], F_DUPFD_CLOEXEC, kHelperRingFd + 1);
+        copied = copied && copies[i] >= 0;
+    }
+    
+    int result = -1;
+    if (copied) {
+        posix_spawn_file_actions_t actions;
+        posix_spawn_file_actions_init(&actions);
+        for (int i = 0; i < 4; i++) {
+            posix_spawn_file_actions_adddup2(&actions, copies[i], targets[i]);
+        }
+        result = posix_spawn(&helperPid, helperPath.c_str(), &actions, nullptr, argv.data(), environ);
+        posix_spawn_file_actions_destroy(&actions);
+    }
+    for (int copy : copies) {
+        if (copy >= 0) {
+            close(copy);
+        }
+    }
+    
+    close(commandPipe[0]);
+    close(replyPipe[1]);
+    ring->closeDescriptor();
+    
+    if (result != 0) {
+        helperPid = -1;
+        close(commandPipe[1]);
+        close(replyPipe[0]);
+        return false;
+    }
+    
+    commandFd = commandPipe[1];
+    replyFd = replyPipe[0];
+    
+    // Keep only the helper's copy of a pipe write end, so its exit reads as EOF
+    wake->closeWriteEnd();
+    return true;
+}
+
+bool RecorderHelperClient::sendCommand(const std::string& command, bool start) {
+    if (!alive || commandFd < 0) {
+        return false;
+    }
+    
+    // Queued under the lock so the consumer never sees a reply before its command
+    std::lock_guard<std::mutex> lock(commandMutex);
+    std::string line = command + "\n";
+    if (write(commandFd, line.data(), line.size()) != static_cast<ssize_t>(line.size())) {
+        return false;
+    }
+    pendingCommands.push_back({start, std::chrono::steady_clock::now()});
+    return true;
+}
+
+bool RecorderHelperClient::startRecording(const std::string& sessionId) {
+    if (recording || isCommandPending()) {
+        return false;
+    }
+    
+    // Commands are newline-terminated; a control character in the id could
+    // end the line early and desynchronize replies from pendingCommands
+    bool hasControl = std::any_of(sessionId.begin(), sessionId.end(),
+        [](char c) { return static_cast<unsigned char>(c) < 0x20 || c == 0x7f; });
+    if (hasControl) {
+        return false;
+    }
+    
+    return sendCommand("start " + sessionId, true);
+}
+
+void RecorderHelperClient::stopRecording() {
+    recording = false;
+    sendCommand("stop", false);
+}
+
+bool RecorderHelperClient::isCommandPending() const {
+    std::lock_guard<std::mutex> lock(commandMutex);
+    return !pendingCommands.empty();
+}
+
+uint64_t RecorderHelperClient::counter(HelperCounter slot) const {
+    return ring ? ring->counter(slot) : 0;
+}
+
+uint64_t RecorderHelperClient::dropped() const {
+    return ring ? ring->dropped() : 0;
+}
+
+void RecorderHelperClient::drain(std::string& record, RecordedStep& step) {
+    while (ring->pop(record)) {
+        if (decodeStep(reinterpret_cast<const uint8_t*>(record.data()), record.size(), step)) {
+            callback(step);
+        }
+    }
+}
+
+bool RecorderHelperClient::readReplies(std::string& record, RecordedStep& step) {
+    char buffer[64];
+    ssize_t received;
+    while ((received = read(replyFd, buffer, sizeof(buffer))) > 0) {
+        replyBuffer.append(buffer, static_cast<size_t>(received));
+    }
+    
+    // Replies are a single "ok" or "error" line, in command order
+    size_t newline;
+    while ((newline = replyBuffer.find('\n')) != std::string::npos) {
+        bool ok = replyBuffer.compare(0, newline, "ok") == 0;
+        replyBuffer.erase(0, newline + 1);
+        
+        // Only this thread pops, so the front stays put while unlocked
+        bool start;
+        {
+            std::lock_guard<std::mutex> lock(commandMutex);
+            if (pendingCommands.empty()) {
+                continue;
+            }
+            start = pendingCommands.front().start;
+        }
+        if (!start) {
+            // The helper has stopped; deliver what it pushed before replying
+            // while the stop still reads as pending
+            drain(record, step);
+        }
+        
+        std::lock_guard<std::mutex> lock(commandMutex);
+        if (start) {
+            // A stop sent in the meantime wins
+            recording = ok && pendingCommands.size() == 1;
+        }
+        pendingCommands.pop_front();
+    }
+    
+    return received != 0;
+}
+
+void RecorderHelperClient::expireCommands() {
+    std::lock_guard<std::mutex> lock(commandMutex);
+    auto now = std::chrono::steady_clock::now();
+    while (!pendingCommands.empty() &&
+           now - pendingCommands.front().sentAt > std::chrono::milliseconds(kReplyTimeoutMs)) {
+        if (pendingCommands.front().start) {
+            recording = false;
+        }
+        pendingCommands.pop_front();
+    }
+}
+
+void RecorderHelperClient::consume() {
+    std::string record;
+    RecordedStep step;
+    int replies = replyFd;
+    
+    while (!stopRequested) {
+        drain(record, step);
+        
+        bool woken = ring->waitForData(*wake, 200, replies);
+        if (replies >= 0 && !readReplies(record, step)) {
+            // Closed reply pipe: the helper is exiting, and the wake channel
+            // or waitpid() below will notice
+            replies = -1;
+        }
+        expireCommands();
+        if (woken) {
+            continue;
+        }
+        
+        int status;
+        if (waitpid(helperPid, &status, WNOHANG) == helperPid) {
+            exited = true;
+            alive = false;
+            if (!stopRequested) {
+                std::cerr << "Recorder helper exited unexpectedly" << std::endl;
+            }
+            break;
+        }
+    }
+    
+    // Whatever the helper managed to publish before stopping still counts
+    drain(record, step);
+    
+    std::lock_guard<std::mutex> lock(commandMutex);
+    pendingCommands.clear();
+    recording = false;
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include "recorder_types.h"
+#include "step_ring.h"
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <sys/types.h>
+#include <thread>
+
+// Counter slots the helper publishes in the ring header
+enum HelperCounter : size_t {
+    kHelperTapTimeoutRecoveries,
+    kHelperTapUserInputRecoveries,
+    kHelperTapLastRecoveryAt,
+    kHelperPrefetches,
+    kHelperPrefetchHits,
+    kHelperPrefetchMisses,
+    kHelperPrefetchStaleHits,
+    kHelperPrefetchHitLatencyMicros,
+    kHelperPrefetchMissLatencyMicros,
+    kHelperPrefetchSavedMicros,
+    kHelperIndexHits,
+    kHelperIndexMisses,
+    kHelperIndexStaleMisses,
+    kHelperIndexInserts,
+    kHelperIndexWindowMoves,
+    kHelperIndexWindowResets,
+    kHelperIndexEvictions,
+    kHelperIndexElements,
+    kHelperIndexWindows,
+    kHelperCounterCount
+};
+
+static_assert(kHelperCounterCount <= StepRing::kCounterSlots, "helper counters exceed ring slots");
+
+// Runs the EventMonitor pipeline in the ax_recorder_helper process and
+// receives its steps over a shared-memory StepRing. A stall or crash in the
+// host process no longer touches input capture, and a helper crash only
+// ends the recording.
+//
+// Commands never wait for the helper on the calling (JS) thread: they are
+// written to its stdin and the replies are read by the consumer thread.
+// isCommandPending() stays true until every command sent has been answered.
+class RecorderHelperClient {
+public:
+    RecorderHelperClient(const std::string& helperPath, const EventFilter& filter, StepCallback callback);
+    ~RecorderHelperClient();
+
+    bool isAlive() const { return alive; }
+    // Returns false if the command could not be sent, or if sessionId holds a
+    // control character, which would split the line-based command;
+    // isRecordingActive() turns true once the helper confirms its taps run
+    bool startRecording(const std::string& sessionId);
+    // Recording reads as stopped at once. The stop stays pending until the
+    // helper confirms it and the steps it recorded before have been delivered.
+    void stopRecording();
+    bool isRecordingActive() const { return recording && alive; }
+    bool isCommandPending() const;
+
+    uint64_t counter(HelperCounter slot) const;
+    uint64_t dropped() const;
+
+private:
+    struct PendingCommand {
+        bool start;
+        std::chrono::steady_clock::time_point sentAt;
+    };
+
+    bool spawn(const std::string& helperPath, const EventFilter& filter);
+    bool sendCommand(const std::string& command, bool start);
+    void consume();
+    void drain(std::string& record, RecordedStep& step);
+    // Consumer thread: handles complete reply lines; false once the pipe closed
+    bool readReplies(std::string& record, RecordedStep& step);
+    void expireCommands();
+
+    StepCallback callback;
+    std::unique_ptr<StepRing> ring;
+    std::unique_ptr<WakeChannel> wake;
+    pid_t helperPid;
+    int commandFd;
+    int replyFd;
+    std::thread consumer;
+    std::atomic<bool> stopRequested;
+    std::atomic<bool> alive;
+    std::atomic<bool> exited;
+    std::atomic<bool> recording;
+
+    mutable std::mutex commandMutex;
+    std::deque<PendingCommand> pendingCommands;
+    std::string replyBuffer; // Consumer thread only
+};
@@ -0,0 +1,93 @@
+#pragma once
+
+// Plain data shared by the event monitor, the addon and the helper
+// transport. No platform headers, so the transport builds anywhere.
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+struct AXPoint {
+    int x;
+    int y;
+};
+
+struct Frame {
+    int x;
+    int y;
+    int width;
+    int height;
+};
+
+struct Modifiers {
+    bool shift = false;
+    bool control = false;
+    bool option = false;
+    bool command = false;
+};
+
+struct ApplicationInfo {
+    std::string name;
+    int processId;
+};
+
+struct TargetDescriptor {
+    std::string role;
+    std::string title;
+    std::string identifier;
+    std::string value;
+    Frame frame;
+    std::vector<std::string> ancestry;
+};
+
+struct RecordedStep {
+    long long timestamp;
+    std::string sessionId;
+    std::string action;
+    std::string button;
+    std::string text;
+    AXPoint location;
+    Modifiers modifiers;
+    TargetDescriptor targetDescriptor;
+    ApplicationInfo appInfo;
+};
+
+// Bit flags for the actions a subscriber wants to receive
+enum StepAction : uint32_t {
+    kStepActionClick = 1u << 0,
+    kStepActionType = 1u << 1,
+    kStepActionDrag = 1u << 2,
+    kStepActionAll = kStepActionClick | kStepActionType | kStepActionDrag
+};
+
+// Subscriber-side filter. Empty / zero fields match everything.
+struct EventFilter {
+    uint32_t actionMask = kStepActionAll;
+    std::string appName;
+    int processId = 0;
+    std::vector<std::string> roles;
+    bool hasRegion = false;
+    Frame region = {0, 0, 0, 0};
+};
+
+// Counts of taps the window server disabled and we turned back on
+struct TapStats {
+    uint64_t timeoutRecoveries = 0;
+    uint64_t userInputRecoveries = 0;
+    long long lastRecoveryAt = 0;
+};
+
+struct PrefetchStats {
+    uint64_t prefetches = 0;
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t staleHits = 0;
+    // Time spent on the click path, split by whether the cache answered
+    uint64_t hitLatencyMicros = 0;
+    uint64_t missLatencyMicros = 0;
+    // AX resolve time that hits did not have to pay on the click path
+    uint64_t savedMicros = 0;
+};
+
+using StepCallback = std::function<void(const RecordedStep&)>;
@@ -0,0 +1,88 @@
+#pragma once
+
+// Hands flow steps to JS, which polls for them, runs them and reports back.
+// Nothing blocks: call() queues the step with its completion callback and
+// returns, and complete() or close() invokes that callback. Only the
+// standard library is used, so it is tested alongside FlowScheduler.
+
+#include "flow_scheduler.h"
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+class StepBroker {
+public:
+    struct Call {
+        uint64_t callId;
+        uint64_t flowId;
+        size_t stepIndex;
+    };
+
+    StepBroker() : nextCallId(1), closed(false) {}
+
+    // Fits ScheduledStep::start
+    void call(uint64_t flowId, size_t stepIndex, StepDone done) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!closed) {
+                uint64_t callId = nextCallId++;
+                ready.push_back({callId, flowId, stepIndex});
+                running.emplace(callId, std::move(done));
+                return;
+            }
+        }
+        done(false);
+    }
+
+    size_t take(std::vector<Call>& out, size_t maxCalls) {
+        std::lock_guard<std::mutex> lock(mutex);
+        out.clear();
+        while (!ready.empty() && out.size() < maxCalls) {
+            out.push_back(ready.front());
+            ready.pop_front();
+        }
+        return out.size();
+    }
+
+    // False for an unknown call, or one failed by close()
+    bool complete(uint64_t callId, bool ok) {
+        StepDone done;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto it = running.find(callId);
+            if (it == running.end()) {
+                return false;
+            }
+            done = std::move(it->second);
+            running.erase(it);
+        }
+        // Outside the lock: done may start the flow's next step, which can
+        // come straight back into call()
+        done(ok);
+        return true;
+    }
+
+    // Fails every queued and running call, and any made afterwards
+    void close() {
+        std::map<uint64_t, StepDone> failed;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            closed = true;
+            ready.clear();
+            failed.swap(running);
+        }
+        for (auto& entry : failed) {
+            entry.second(false);
+        }
+    }
+
+private:
+    std::mutex mutex;
+    std::deque<Call> ready;
+    std::map<uint64_t, StepDone> running; // Queued or handed to JS
+    uint64_t nextCallId;
+    bool closed;
+};
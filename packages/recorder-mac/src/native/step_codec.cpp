@@ -0,0 +1,126 @@
+#include "step_codec.h"
+#include <cstring>
+
+namespace {
+
+template <typename T>
+void writeValue(std::string& out, T value) {
+    out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+void writeString(std::string& out, const std::string& value) {
+    writeValue<uint32_t>(out, static_cast<uint32_t>(value.size()));
+    out.append(value);
+}
+
+class Reader {
+public:
+    Reader(const uint8_t* data, size_t size) : data(data), size(size), offset(0), ok(true) {}
+    
+    template <typename T>
+    T value() {
+        T result{};
+        if (!ok || size - offset < sizeof(T)) {
+            ok = false;
+            return result;
+        }
+        std::memcpy(&result, data + offset, sizeof(T));
+        offset += sizeof(T);
+        return result;
+    }
+    
+    std::string string() {
+        uint32_t length = value<uint32_t>();
+        if (!ok || size - offset < length) {
+            ok = false;
+            return std::string();
+        }
+        std::string result(reinterpret_cast<const char*>(data + offset), length);
+        offset += length;
+        return result;
+    }
+    
+    bool good() const { return ok; }
+    
+private:
+    const uint8_t* data;
+    size_t size;
+    size_t offset;
+    bool ok;
+};
+
+}
+
+void encodeStep(const RecordedStep& step, std::string& out) {
+    out.clear();
+    
+    writeValue<int64_t>(out, step.timestamp);
+    writeString(out, step.sessionId);
+    writeString(out, step.action);
+    writeString(out, step.button);
+    writeString(out, step.text);
+    writeValue<int32_t>(out, step.location.x);
+    writeValue<int32_t>(out, step.location.y);
+    
+    uint8_t modifiers = (step.modifiers.shift ? 1 : 0) |
+                        (step.modifiers.control ? 2 : 0) |
+                        (step.modifiers.option ? 4 : 0) |
+                        (step.modifiers.command ? 8 : 0);
+    writeValue<uint8_t>(out, modifiers);
+    
+    const TargetDescriptor& target = step.targetDescriptor;
+    writeString(out, target.role);
+    writeString(out, target.title);
+    writeString(out, target.identifier);
+    writeString(out, target.value);
+    writeValue<int32_t>(out, target.frame.x);
+    writeValue<int32_t>(out, target.frame.y);
+    writeValue<int32_t>(out, target.frame.width);
+    writeValue<int32_t>(out, target.frame.height);
+    writeValue<uint32_t>(out, static_cast<uint32_t>(target.ancestry.size()));
+    for (const std::string& component : target.ancestry) {
+        writeString(out, component);
+    }
+    
+    writeString(out, step.appInfo.name);
+    writeValue<int32_t>(out, step.appInfo.processId);
+}
+
+bool decodeStep(const uint8_t* data, size_t size, RecordedStep& step) {
+    Reader reader(data, size);
+    
+    step.timestamp = reader.value<int64_t>();
+    step.sessionId = reader.string();
+    step.action = reader.string();
+    step.button = reader.string();
+    step.text = reader.string();
+    step.location.x = reader.value<int32_t>();
+    step.location.y = reader.value<int32_t>();
+    
+    uint8_t modifiers = reader.value<uint8_t>();
+    step.modifiers.shift = (modifiers & 1) != 0;
+    step.modifiers.control = (modifiers & 2) != 0;
+    step.modifiers.option = (modifiers & 4) != 0;
+    step.modifiers.command = (modifiers & 8) != 0;
+    
+    TargetDescriptor& target = step.targetDescriptor;
+    target.role = reader.string();
+    target.title = reader.string();
+    target.identifier = reader.string();
+    target.value = reader.string();
+    target.frame.x = reader.value<int32_t>();
+    target.frame.y = reader.value<int32_t>();
+    target.frame.width = reader.value<int32_t>();
+    target.frame.height = reader.value<int32_t>();
+    
+    uint32_t ancestryCount = reader.value<uint32_t>();
+    target.ancestry.clear();
+    for (uint32_t i = 0; i < ancestryCount && reader.good(); i++) {
+        target.ancestry.push_back(reader.string());
+    }
+    
+    step.appInfo.name = reader.string();
+    step.appInfo.processId = reader.value<int32_t>();
+    
+    return reader.good();
+}
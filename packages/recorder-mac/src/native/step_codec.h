@@ -0,0 +1,11 @@
+#pragma once
+
+#include "recorder_types.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Compact binary encoding of RecordedStep for the helper transport. Both
+// ends run on the same machine, so fields are written in native byte order.
+void encodeStep(const RecordedStep& step, std::string& out);
+bool decodeStep(const uint8_t* data, size_t size, RecordedStep& step);
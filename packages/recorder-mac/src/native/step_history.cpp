@@ -0,0 +1,234 @@
+#include "step_history.h"
+#include "step_js.h"
+#include "step_store.h"
+#include <memory>
+
+class StepHistory : public Napi::ObjectWrap<StepHistory> {
+public:
+    static Napi::Object Init(Napi::Env env, Napi::Object exports);
+    StepHistory(const Napi::CallbackInfo& info);
+    
+    Napi::Value Append(const Napi::CallbackInfo& info);
+    Napi::Value Flush(const Napi::CallbackInfo& info);
+    Napi::Value Refresh(const Napi::CallbackInfo& info);
+    Napi::Value Query(const Napi::CallbackInfo& info);
+    Napi::Value GetStats(const Napi::CallbackInfo& info);
+
+private:
+    static StepQuery QueryFromJS(const Napi::Object& options);
+    static void TermsFromJS(const Napi::Object& options, const char* name, std::vector<std::string>& terms);
+    
+    std::unique_ptr<StepStoreWriter> writer;
+    StepStore store;
+};
+
+Napi::Object StepHistory::Init(Napi::Env env, Napi::Object exports) {
+    Napi::Function func = DefineClass(env, "StepHistory", {
+        InstanceMethod("append", &StepHistory::Append),
+        InstanceMethod("flush", &StepHistory::Flush),
+        InstanceMethod("refresh", &StepHistory::Refresh),
+        InstanceMethod("query", &StepHistory::Query),
+        InstanceMethod("getStats", &StepHistory::GetStats)
+    });
+    
+    exports.Set("StepHistory", func);
+    return exports;
+}
+
+StepHistory::StepHistory(const Napi::CallbackInfo& info) : Napi::ObjectWrap<StepHistory>(info) {
+    Napi::Env env = info.Env();
+    
+    if (info.Length() < 1 || !info[0].IsString()) {
+        Napi::TypeError::New(env, "History directory string expected").ThrowAsJavaScriptException();
+        return;
+    }
+    std::string directory = info[0].As<Napi::String>().Utf8Value();
+    
+    size_t segmentSteps = 65536;
+    if (info.Length() > 1 && info[1].IsObject()) {
+        Napi::Object options = info[1].As<Napi::Object>();
+        if (options.Has("segmentSteps") && options.Get("segmentSteps").IsNumber()) {
+            segmentSteps = options.Get("segmentSteps").As<Napi::Number>().Uint32Value();
+        }
+    }
+    
+    // The writer creates the directory, so it is opened first
+    std::string error;
+    writer.reset(new StepStoreWriter(segmentSteps));
+    if (!writer->open(directory, error) || !store.open(directory, error)) {
+        Napi::Error::New(env, error).ThrowAsJavaScriptException();
+        return;
+    }
+}
+
+Napi::Value StepHistory::Append(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    
+    if (info.Length() < 1 || !info[0].IsArray()) {
+        Napi::TypeError::New(env, "Array of recorded steps expected").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    
+    Napi::Array steps = info[0].As<Napi::Array>();
+    std::string error;
+    uint32_t appended = 0;
+    bool wroteSegment = false;
+    bool ok = true;
+    for (uint32_t i = 0; i < steps.Length() && ok; i++) {
+        if (!steps.Get(i).IsObject()) {
+            continue;
+        }
+        size_t pendingBefore = writer->pending();
+        ok = writer->append(RecordedStepFromJS(steps.Get(i).As<Napi::Object>()), error);
+        // The buffer only shrinks when a full segment was written out
+        wroteSegment = wroteSegment || writer->pending() <= pendingBefore;
+        appended += ok ? 1 : 0;
+    }
+    
+    // Map segments written along the way, so appended steps are queryable
+    // as soon as they are on disk
+    std::string refreshError;
+    if (wroteSegment && !store.refresh(refreshError) && ok) {
+        ok = false;
+        error = refreshError;
+    }
+    if (!ok) {
+        Napi::Error::New(env, error).ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    
+    return Napi::Number::New(env, appended);
+}
+
+Napi::Value StepHistory::Flush(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    
+    std::string error;
+    if (!writer->flush(error) || !store.refresh(error)) {
+        Napi::Error::New(env, error).ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    
+    return Napi::Boolean::New(env, true);
+}
+
+Napi::Value StepHistory::Refresh(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    
+    std::string error;
+    if (!store.refresh(error)) {
+        Napi::Error::New(env, error).ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    
+    return Napi::Boolean::New(env, true);
+}
+
+void StepHistory::TermsFromJS(const Napi::Object& options, const char* name, std::vector<std::string>& terms) {
+    if (!options.Has(name) || !options.Get(name).IsArray()) {
+        return;
+    }
+    Napi::Array values = options.Get(name).As<Napi::Array>();
+    for (uint32_t i = 0; i < values.Length(); i++) {
+        if (values.Get(i).IsString()) {
+            terms.push_back(values.Get(i).As<Napi::String>().Utf8Value());
+        }
+    }
+}
+
+StepQuery StepHistory::QueryFromJS(const Napi::Object& options) {
+    StepQuery query;
+    
+    if (options.Has("from") && options.Get("from").IsNumber()) {
+        query.from = options.Get("from").As<Napi::Number>().Int64Value();
+    }
+    if (options.Has("until") && options.Get("until").IsNumber()) {
+        query.until = options.Get("until").As<Napi::Number>().Int64Value();
+    }
+    
+    TermsFromJS(options, "apps", query.terms[kStepFieldApp]);
+    TermsFromJS(options, "actions", query.terms[kStepFieldAction]);
+    TermsFromJS(options, "roles", query.terms[kStepFieldRole]);
+    TermsFromJS(options, "identifiers", query.terms[kStepFieldIdentifier]);
+    TermsFromJS(options, "sessionIds", query.terms[kStepFieldSession]);
+    
+    query.newestFirst = options.Has("newestFirst") && options.Get("newestFirst").IsBoolean() &&
+                        options.Get("newestFirst").As<Napi::Boolean>().Value();
+    
+    if (options.Has("limit") && options.Get("limit").IsNumber()) {
+        query.limit = options.Get("limit").As<Napi::Number>().Uint32Value();
+    }
+    
+    if (options.Has("after") && options.Get("after").IsObject()) {
+        Napi::Object after = options.Get("after").As<Napi::Object>();
+        if (after.Has("timestamp") && after.Get("timestamp").IsNumber() &&
+            after.Has("segment") && after.Get("segment").IsNumber() &&
+            after.Has("row") && after.Get("row").IsNumber()) {
+            query.hasCursor = true;
+            query.after.timestamp = after.Get("timestamp").As<Napi::Number>().Int64Value();
+            query.after.segment = after.Get("segment").As<Napi::Number>().Uint32Value();
+            query.after.row = after.Get("row").As<Napi::Number>().Uint32Value();
+        }
+    }
+    
+    return query;
+}
+
+Napi::Value StepHistory::Query(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    
+    StepQuery query;
+    if (info.Length() > 0 && info[0].IsObject()) {
+        query = QueryFromJS(info[0].As<Napi::Object>());
+    }
+    
+    StepPage page;
+    std::string error;
+    if (!store.query(query, page, error)) {
+        Napi::Error::New(env, error).ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    
+    Napi::Array steps = Napi::Array::New(env, page.steps.size());
+    for (size_t i = 0; i < page.steps.size(); i++) {
+        steps[i] = RecordedStepToJS(env, page.steps[i]);
+    }
+    
+    Napi::Object obj = Napi::Object::New(env);
+    obj.Set("steps", steps);
+    obj.Set("hasMore", Napi::Boolean::New(env, page.hasMore));
+    if (page.steps.empty()) {
+        obj.Set("next", env.Null());
+    } else {
+        Napi::Object next = Napi::Object::New(env);
+        next.Set("timestamp", Napi::Number::New(env, static_cast<double>(page.next.timestamp)));
+        next.Set("segment", Napi::Number::New(env, page.next.segment));
+        next.Set("row", Napi::Number::New(env, page.next.row));
+        obj.Set("next", next);
+    }
+    obj.Set("segmentsSearched", Napi::Number::New(env, static_cast<double>(page.segmentsSearched)));
+    obj.Set("segmentsSkipped", Napi::Number::New(env, static_cast<double>(page.segmentsSkipped)));
+    
+    return obj;
+}
+
+Napi::Value StepHistory::GetStats(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    
+    StepStoreStats stats = store.stats();
+    
+    Napi::Object obj = Napi::Object::New(env);
+    obj.Set("segments", Napi::Number::New(env, static_cast<double>(stats.segments)));
+    obj.Set("corruptSegments", Napi::Number::New(env, static_cast<double>(stats.corruptSegments)));
+    obj.Set("steps", Napi::Number::New(env, static_cast<double>(stats.steps)));
+    obj.Set("pendingSteps", Napi::Number::New(env, static_cast<double>(writer->pending())));
+    obj.Set("mappedBytes", Napi::Number::New(env, static_cast<double>(stats.mappedBytes)));
+    obj.Set("minTimestamp", Napi::Number::New(env, static_cast<double>(stats.minTimestamp)));
+    obj.Set("maxTimestamp", Napi::Number::New(env, static_cast<double>(stats.maxTimestamp)));
+    
+    return obj;
+}
+
+Napi::Object InitStepHistory(Napi::Env env, Napi::Object exports) {
+    return StepHistory::Init(env, exports);
+}
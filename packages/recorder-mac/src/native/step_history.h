@@ -0,0 +1,6 @@
+#pragma once
+
+#include <napi.h>
+
+// Registers the StepHistory class, the JS face of StepStore
+Napi::Object InitStepHistory(Napi::Env env, Napi::Object exports);
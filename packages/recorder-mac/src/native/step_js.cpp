@@ -0,0 +1,131 @@
+#include "step_js.h"
+
+Napi::Object RecordedStepToJS(Napi::Env env, const RecordedStep& step) {
+    Napi::Object obj = Napi::Object::New(env);
+    
+    obj.Set("timestamp", Napi::Number::New(env, step.timestamp));
+    obj.Set("sessionId", Napi::String::New(env, step.sessionId));
+    obj.Set("action", Napi::String::New(env, step.action));
+    
+    if (!step.button.empty()) {
+        obj.Set("button", Napi::String::New(env, step.button));
+    }
+    
+    if (!step.text.empty()) {
+        obj.Set("text", Napi::String::New(env, step.text));
+    }
+    
+    Napi::Object location = Napi::Object::New(env);
+    location.Set("x", Napi::Number::New(env, step.location.x));
+    location.Set("y", Napi::Number::New(env, step.location.y));
+    obj.Set("location", location);
+    
+    Napi::Object modifiers = Napi::Object::New(env);
+    modifiers.Set("shift", Napi::Boolean::New(env, step.modifiers.shift));
+    modifiers.Set("control", Napi::Boolean::New(env, step.modifiers.control));
+    modifiers.Set("option", Napi::Boolean::New(env, step.modifiers.option));
+    modifiers.Set("command", Napi::Boolean::New(env, step.modifiers.command));
+    obj.Set("modifiers", modifiers);
+    
+    Napi::Object target = Napi::Object::New(env);
+    target.Set("role", Napi::String::New(env, step.targetDescriptor.role));
+    target.Set("title", Napi::String::New(env, step.targetDescriptor.title));
+    target.Set("identifier", Napi::String::New(env, step.targetDescriptor.identifier));
+    target.Set("value", Napi::String::New(env, step.targetDescriptor.value));
+    
+    Napi::Object frame = Napi::Object::New(env);
+    frame.Set("x", Napi::Number::New(env, step.targetDescriptor.frame.x));
+    frame.Set("y", Napi::Number::New(env, step.targetDescriptor.frame.y));
+    frame.Set("width", Napi::Number::New(env, step.targetDescriptor.frame.width));
+    frame.Set("height", Napi::Number::New(env, step.targetDescriptor.frame.height));
+    target.Set("frame", frame);
+    
+    Napi::Array ancestry = Napi::Array::New(env, step.targetDescriptor.ancestry.size());
+    for (size_t i = 0; i < step.targetDescriptor.ancestry.size(); i++) {
+        ancestry[i] = Napi::String::New(env, step.targetDescriptor.ancestry[i]);
+    }
+    target.Set("ancestry", ancestry);
+    obj.Set("targetDescriptor", target);
+    
+    Napi::Object appInfo = Napi::Object::New(env);
+    appInfo.Set("name", Napi::String::New(env, step.appInfo.name));
+    appInfo.Set("processId", Napi::Number::New(env, step.appInfo.processId));
+    obj.Set("appInfo", appInfo);
+    
+    return obj;
+}
+
+static std::string StringField(const Napi::Object& object, const char* name) {
+    if (object.Has(name) && object.Get(name).IsString()) {
+        return object.Get(name).As<Napi::String>().Utf8Value();
+    }
+    return std::string();
+}
+
+static int IntField(const Napi::Object& object, const char* name) {
+    if (object.Has(name) && object.Get(name).IsNumber()) {
+        return object.Get(name).As<Napi::Number>().Int32Value();
+    }
+    return 0;
+}
+
+static bool BoolField(const Napi::Object& object, const char* name) {
+    return object.Has(name) && object.Get(name).IsBoolean() && object.Get(name).As<Napi::Boolean>().Value();
+}
+
+static Napi::Object ObjectField(const Napi::Object& object, const char* name) {
+    if (object.Has(name) && object.Get(name).IsObject()) {
+        return object.Get(name).As<Napi::Object>();
+    }
+    return Napi::Object::New(object.Env());
+}
+
+RecordedStep RecordedStepFromJS(const Napi::Object& object) {
+    RecordedStep step;
+    
+    step.timestamp = 0;
+    if (object.Has("timestamp") && object.Get("timestamp").IsNumber()) {
+        step.timestamp = object.Get("timestamp").As<Napi::Number>().Int64Value();
+    }
+    step.sessionId = StringField(object, "sessionId");
+    step.action = StringField(object, "action");
+    step.button = StringField(object, "button");
+    step.text = StringField(object, "text");
+    
+    Napi::Object location = ObjectField(object, "location");
+    step.location.x = IntField(location, "x");
+    step.location.y = IntField(location, "y");
+    
+    Napi::Object modifiers = ObjectField(object, "modifiers");
+    step.modifiers.shift = BoolField(modifiers, "shift");
+    step.modifiers.control = BoolField(modifiers, "control");
+    step.modifiers.option = BoolField(modifiers, "option");
+    step.modifiers.command = BoolField(modifiers, "command");
+    
+    Napi::Object target = ObjectField(object, "targetDescriptor");
+    step.targetDescriptor.role = StringField(target, "role");
+    step.targetDescriptor.title = StringField(target, "title");
+    step.targetDescriptor.identifier = StringField(target, "identifier");
+    step.targetDescriptor.value = StringField(target, "value");
+    
+    Napi::Object frame = ObjectField(target, "frame");
+    step.targetDescriptor.frame.x = IntField(frame, "x");
+    step.targetDescriptor.frame.y = IntField(frame, "y");
+    step.targetDescriptor.frame.width = IntField(frame, "width");
+    step.targetDescriptor.frame.height = IntField(frame, "height");
+    
+    if (target.Has("ancestry") && target.Get("ancestry").IsArray()) {
+        Napi::Array ancestry = target.Get("ancestry").As<Napi::Array>();
+        for (uint32_t i = 0; i < ancestry.Length(); i++) {
+            if (ancestry.Get(i).IsString()) {
+                step.targetDescriptor.ancestry.push_back(ancestry.Get(i).As<Napi::String>().Utf8Value());
+            }
+        }
+    }
+    
+    Napi::Object appInfo = ObjectField(object, "appInfo");
+    step.appInfo.name = StringField(appInfo, "name");
+    step.appInfo.processId = IntField(appInfo, "processId");
+    
+    return step;
+}
@@ -0,0 +1,9 @@
+#pragma once
+
+#include <napi.h>
+#include "recorder_types.h"
+
+// Conversions between RecordedStep and the JS RecordedStep interface
+Napi::Object RecordedStepToJS(Napi::Env env, const RecordedStep& step);
+// Missing or mistyped fields are left at their defaults
+RecordedStep RecordedStepFromJS(const Napi::Object& object);
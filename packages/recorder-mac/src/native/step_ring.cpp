@@ -0,0 +1,295 @@
+#include "step_ring.h"
+#include <cerrno>
+#include <cstring>
+#include <new>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/eventfd.h>
+#endif
+
+namespace {
+
+const uint32_t kRingMagic = 0x41585253; // "AXRS"
+const uint32_t kRingVersion = 1;
+const uint32_t kWrapMarker = 0xFFFFFFFFu;
+
+size_t align8(size_t size) {
+    return (size + 7) & ~static_cast<size_t>(7);
+}
+
+size_t headerSize() {
+    return 4096;
+}
+
+}
+
+std::unique_ptr<WakeChannel> WakeChannel::create() {
+#ifdef __linux__
+    int fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (fd < 0) {
+        return nullptr;
+    }
+    return std::unique_ptr<WakeChannel>(new WakeChannel(fd, fd));
+#else
+    int fds[2];
+    if (pipe(fds) != 0) {
+        return nullptr;
+    }
+    for (int fd : fds) {
+        fcntl(fd, F_SETFL, O_NONBLOCK);
+        fcntl(fd, F_SETFD, FD_CLOEXEC);
+    }
+    return std::unique_ptr<WakeChannel>(new WakeChannel(fds[0], fds[1]));
+#endif
+}
+
+std::unique_ptr<WakeChannel> WakeChannel::fromFd(int fd) {
+    return std::unique_ptr<WakeChannel>(new WakeChannel(-1, fd));
+}
+
+WakeChannel::~WakeChannel() {
+    if (readEnd >= 0) {
+        close(readEnd);
+    }
+    if (writeEnd >= 0 && writeEnd != readEnd) {
+        close(writeEnd);
+    }
+}
+
+void WakeChannel::closeWriteEnd() {
+    if (writeEnd >= 0 && writeEnd != readEnd) {
+        close(writeEnd);
+    }
+    writeEnd = -1;
+}
+
+void WakeChannel::signal() {
+#ifdef __linux__
+    uint64_t one = 1;
+    ssize_t written = write(writeEnd, &one, sizeof(one));
+#else
+    char byte = 1;
+    ssize_t written = write(writeEnd, &byte, 1);
+#endif
+    // A full pipe or saturated eventfd already guarantees a wakeup
+    (void)written;
+}
+
+bool WakeChannel::wait(int timeoutMs, int otherFd) {
+    struct pollfd pfds[2] = {{readEnd, POLLIN, 0}, {otherFd, POLLIN, 0}};
+    int ready = poll(pfds, otherFd >= 0 ? 2 : 1, timeoutMs);
+    if (ready <= 0) {
+        return false;
+    }
+    if (pfds[0].revents == 0) {
+        return true;
+    }
+    
+    // Drain so the next wait blocks again
+    uint8_t buffer[64];
+    ssize_t received;
+    do {
+        received = read(readEnd, buffer, sizeof(buffer));
+    } while (received == static_cast<ssize_t>(sizeof(buffer)));
+    
+    // A closed pipe reads as EOF: the producer process is gone
+    return received != 0;
+}
+
+StepRing::StepRing(int fd, void* mapping, size_t mappingSize) :
+    fd(fd),
+    mapping(mapping),
+    mappingSize(mappingSize),
+    header(static_cast<Header*>(mapping)),
+    data(static_cast<uint8_t*>(mapping) + headerSize()),
+    mask(header->capacity - 1) {}
+
+StepRing::~StepRing() {
+    munmap(mapping, mappingSize);
+    closeDescriptor();
+}
+
+void StepRing::closeDescriptor() {
+    if (fd >= 0) {
+        close(fd);
+        fd = -1;
+    }
+}
+
+std::unique_ptr<StepRing> StepRing::create(const std::string& name, size_t capacity) {
+    static_assert(sizeof(Header) <= 4096, "ring header must fit in its page");
+    
+    // Round up to a power of two so positions can be masked
+    size_t rounded = 4096;
+    while (rounded < capacity) {
+        rounded <<= 1;
+    }
+    
+    int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd < 0) {
+        return nullptr;
+    }
+    // The name was only needed to get a descriptor; the segment now lives as
+    // long as some process has it open or mapped
+    shm_unlink(name.c_str());
+    
+    size_t mappingSize = headerSize() + rounded;
+    if (ftruncate(fd, static_cast<off_t>(mappingSize)) != 0) {
+        close(fd);
+        return nullptr;
+    }
+    
+    void* mapping = mmap(nullptr, mappingSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (mapping == MAP_FAILED) {
+        close(fd);
+        return nullptr;
+    }
+    
+    Header* header = new (mapping) Header();
+    header->magic = kRingMagic;
+    header->version = kRingVersion;
+    header->capacity = rounded;
+    header->head.store(0);
+    header->tail.store(0);
+    header->consumerWaiting.store(0);
+    header->dropped.store(0);
+    for (size_t i = 0; i < kCounterSlots; i++) {
+        header->counters[i].store(0);
+    }
+    
+    return std::unique_ptr<StepRing>(new StepRing(fd, mapping, mappingSize));
+}
+
+std::unique_ptr<StepRing> StepRing::fromFd(int fd) {
+    if (fd < 0) {
+        return nullptr;
+    }
+    
+    struct stat info;
+    if (fstat(fd, &info) != 0 || static_cast<size_t>(info.st_size) <= headerSize()) {
+        close(fd);
+        return nullptr;
+    }
+    
+    // The header says how much of the segment is ring; macOS rounds shared
+    // memory up to whole pages, so the segment may be larger than that
+    void* headerMapping = mmap(nullptr, headerSize(), PROT_READ, MAP_SHARED, fd, 0);
+    if (headerMapping == MAP_FAILED) {
+        close(fd);
+        return nullptr;
+    }
+    const Header* mappedHeader = static_cast<const Header*>(headerMapping);
+    uint64_t capacity = mappedHeader->capacity;
+    bool valid = mappedHeader->magic == kRingMagic && mappedHeader->version == kRingVersion &&
+                 capacity >= 4096 && (capacity & (capacity - 1)) == 0 &&
+                 capacity <= static_cast<uint64_t>(info.st_size) - headerSize();
+    munmap(headerMapping, headerSize());
+    if (!valid) {
+        close(fd);
+        return nullptr;
+    }
+    
+    size_t mappingSize = headerSize() + static_cast<size_t>(capacity);
+    void* mapping = mmap(nullptr, mappingSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        return nullptr;
+    }
+    
+    return std::unique_ptr<StepRing>(new StepRing(-1, mapping, mappingSize));
+}
+
+bool StepRing::push(const void* bytes, size_t size, WakeChannel* wake) {
+    const uint64_t capacity = header->capacity;
+    size_t recordSize = align8(sizeof(uint32_t) + size);
+    if (recordSize > capacity / 2) {
+        header->dropped.fetch_add(1);
+        return false;
+    }
+    
+    uint64_t head = header->head.load(std::memory_order_relaxed);
+    uint64_t tail = header->tail.load(std::memory_order_acquire);
+    size_t offset = static_cast<size_t>(head & mask);
+    size_t contiguous = static_cast<size_t>(capacity - offset);
+    size_t needed = recordSize + (contiguous < recordSize ? contiguous : 0);
+    
+    if (head - tail + needed > capacity) {
+        header->dropped.fetch_add(1);
+        return false;
+    }
+    
+    // Records never straddle the end; mark the remainder and start over at 0
+    if (contiguous < recordSize) {
+        std::memcpy(data + offset, &kWrapMarker, sizeof(kWrapMarker));
+        head += contiguous;
+        offset = 0;
+    }
+    
+    uint32_t length = static_cast<uint32_t>(size);
+    std::memcpy(data + offset, &length, sizeof(length));
+    std::memcpy(data + offset + sizeof(length), bytes, size);
+    
+    // seq_cst pairs with the consumer's waiting flag: either it sees the new
+    // head before sleeping, or we see the flag and wake it
+    header->head.store(head + recordSize, std::memory_order_seq_cst);
+    
+    if (wake && header->consumerWaiting.load(std::memory_order_seq_cst) != 0 &&
+        header->consumerWaiting.exchange(0) != 0) {
+        wake->signal();
+    }
+    
+    return true;
+}
+
+bool StepRing::pop(std::string& out) {
+    uint64_t tail = header->tail.load(std::memory_order_relaxed);
+    uint64_t head = header->head.load(std::memory_order_acquire);
+    if (tail == head) {
+        return false;
+    }
+    
+    size_t offset = static_cast<size_t>(tail & mask);
+    uint32_t length;
+    std::memcpy(&length, data + offset, sizeof(length));
+    
+    if (length == kWrapMarker) {
+        tail += header->capacity - offset;
+        offset = 0;
+        std::memcpy(&length, data, sizeof(length));
+    }
+    
+    out.assign(reinterpret_cast<const char*>(data + offset + sizeof(length)), length);
+    header->tail.store(tail + align8(sizeof(length) + length), std::memory_order_release);
+    return true;
+}
+
+bool StepRing::waitForData(WakeChannel& wake, int timeoutMs, int otherFd) {
+    header->consumerWaiting.store(1, std::memory_order_seq_cst);
+    
+    if (header->head.load(std::memory_order_seq_cst) != header->tail.load(std::memory_order_relaxed)) {
+        header->consumerWaiting.store(0);
+        return true;
+    }
+    
+    bool woken = wake.wait(timeoutMs, otherFd);
+    header->consumerWaiting.store(0);
+    return woken;
+}
+
+void StepRing::setCounter(size_t slot, uint64_t value) {
+    if (slot < kCounterSlots) {
+        header->counters[slot].store(value, std::memory_order_relaxed);
+    }
+}
+
+uint64_t StepRing::counter(size_t slot) const {
+    return slot < kCounterSlots ? header->counters[slot].load(std::memory_order_relaxed) : 0;
+}
+
+uint64_t StepRing::dropped() const {
+    return header->dropped.load();
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+// Single-producer/single-consumer byte ring in POSIX shared memory, used to
+// stream encoded steps from the recorder helper process to the addon.
+// Wakeups go over an eventfd (Linux) or a pipe; the producer only signals
+// when the consumer has announced it is about to sleep.
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+class WakeChannel {
+public:
+    static std::unique_ptr<WakeChannel> create();
+    // Wraps a descriptor inherited from the parent process (producer side)
+    static std::unique_ptr<WakeChannel> fromFd(int fd);
+    ~WakeChannel();
+
+    void signal();
+    // Returns false on timeout or if the producer end has gone away. When
+    // `otherFd` is given, also returns true as soon as it becomes readable.
+    bool wait(int timeoutMs, int otherFd = -1);
+
+    int readFd() const { return readEnd; }
+    int writeFd() const { return writeEnd; }
+    void closeWriteEnd();
+
+private:
+    WakeChannel(int readEnd, int writeEnd) : readEnd(readEnd), writeEnd(writeEnd) {}
+
+    int readEnd;
+    int writeEnd;
+};
+
+class StepRing {
+public:
+    static constexpr size_t kCounterSlots = 24;
+
+    // Consumer side creates the segment. Its name is unlinked before create()
+    // returns, so a crash on either side cannot leak it; the producer maps it
+    // through descriptor(), inherited across spawn.
+    static std::unique_ptr<StepRing> create(const std::string& name, size_t capacity);
+    // Producer side: maps an inherited descriptor and closes it
+    static std::unique_ptr<StepRing> fromFd(int fd);
+    ~StepRing();
+
+    int descriptor() const { return fd; }
+    // Once the producer has its copy, the consumer needs only the mapping
+    void closeDescriptor();
+
+    // Producer: never blocks. Returns false and counts a drop if the ring is full.
+    bool push(const void* data, size_t size, WakeChannel* wake);
+
+    // Consumer: returns false if the ring is empty
+    bool pop(std::string& out);
+
+    // Consumer: sleeps until the producer signals new data, `otherFd` becomes
+    // readable, or the timeout expires
+    bool waitForData(WakeChannel& wake, int timeoutMs, int otherFd = -1);
+
+    // Out-of-band counters the producer publishes for the consumer to read
+    void setCounter(size_t slot, uint64_t value);
+    uint64_t counter(size_t slot) const;
+
+    uint64_t dropped() const;
+
+private:
+    struct Header {
+        uint32_t magic;
+        uint32_t version;
+        uint64_t capacity;
+        alignas(64) std::atomic<uint64_t> head;
+        alignas(64) std::atomic<uint64_t> tail;
+        alignas(64) std::atomic<uint32_t> consumerWaiting;
+        std::atomic<uint64_t> dropped;
+        std::atomic<uint64_t> counters[kCounterSlots];
+    };
+
+    static_assert(std::atomic<uint64_t>::is_always_lock_free,
+                  "ring atomics must be address-free to live in shared memory");
+
+    StepRing(int fd, void* mapping, size_t mappingSize);
+
+    int fd;
+    void* mapping;
+    size_t mappingSize;
+    Header* header;
+    uint8_t* data;
+    uint64_t mask;
+};
@@ -0,0 +1,704 @@
+#include "step_store.h"
+#include "step_codec.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <map>
+#include <queue>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+const char kSegmentMagic[4] = {'A', 'X', 'S', 'H'};
+const uint32_t kSegmentVersion = 1;
+
+// Segment layout, all offsets from the start of the file:
+//   header | timestamps int64[n] | record index uint64[n + 1] |
+//   field sections | encoded records
+struct SegmentHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t stepCount;
+    uint32_t reserved;
+    int64_t minTimestamp;
+    int64_t maxTimestamp;
+    uint64_t timestampsOffset;
+    uint64_t recordIndexOffset;
+    uint64_t fieldOffsets[kStepFieldCount];
+    uint64_t recordsOffset;
+    uint64_t fileSize;
+};
+
+// Field section: uint32 termCount, uint32 reserved, TermEntry[termCount],
+// postings, term text. Offsets are from the start of the section; terms are
+// sorted bytewise and each posting list is sorted by row.
+struct TermEntry {
+    uint32_t textOffset;
+    uint32_t textLength;
+    uint32_t postingsOffset;
+    uint32_t postingsCount;
+};
+
+const uint32_t kNoRow = UINT32_MAX;
+
+const std::string& fieldValue(const RecordedStep& step, int field) {
+    switch (field) {
+        case kStepFieldApp: return step.appInfo.name;
+        case kStepFieldAction: return step.action;
+        case kStepFieldRole: return step.targetDescriptor.role;
+        case kStepFieldIdentifier: return step.targetDescriptor.identifier;
+        default: return step.sessionId;
+    }
+}
+
+bool parseSegmentName(const char* name, uint32_t& number) {
+    unsigned value = 0;
+    int consumed = 0;
+    if (sscanf(name, "segment-%u.axh%n", &value, &consumed) != 1 || name[consumed] != '\0') {
+        return false;
+    }
+    number = value;
+    return true;
+}
+
+std::string segmentName(uint32_t number) {
+    char name[32];
+    snprintf(name, sizeof(name), "segment-%010u.axh", number);
+    return name;
+}
+
+void alignTo8(std::string& out) {
+    out.resize((out.size() + 7) & ~static_cast<size_t>(7), '\0');
+}
+
+template <typename T>
+void writeValue(std::string& out, T value) {
+    out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+bool listSegments(const std::string& directory, std::vector<uint32_t>& numbers, std::string& error) {
+    DIR* dir = opendir(directory.c_str());
+    if (!dir) {
+        error = "Failed to open history directory " + directory + ": " + strerror(errno);
+        return false;
+    }
+    while (struct dirent* entry = readdir(dir)) {
+        uint32_t number;
+        if (parseSegmentName(entry->d_name, number)) {
+            numbers.push_back(number);
+        }
+    }
+    closedir(dir);
+    std::sort(numbers.begin(), numbers.end());
+    return true;
+}
+
+}
+
+struct StepSegment {
+    struct FieldIndex {
+        const TermEntry* terms = nullptr;
+        uint32_t termCount = 0;
+        const uint8_t* section = nullptr;
+        uint64_t sectionSize = 0;
+    };
+
+    uint32_t number = 0;
+    const uint8_t* base = nullptr;
+    size_t size = 0;
+    SegmentHeader header;
+    const int64_t* timestamps = nullptr;
+    const uint64_t* recordIndex = nullptr;
+    const uint8_t* records = nullptr;
+    uint64_t recordsSize = 0;
+    FieldIndex fields[kStepFieldCount];
+
+    ~StepSegment() {
+        if (base) {
+            munmap(const_cast<uint8_t*>(base), size);
+        }
+    }
+
+    bool map(const std::string& path, std::string& error);
+
+    // Row ids for a term, or false when the segment does not contain it
+    bool postings(int field, const std::string& term, const uint32_t*& begin, const uint32_t*& end) const;
+
+    uint32_t lowerRow(long long timestamp) const {
+        return static_cast<uint32_t>(std::lower_bound(timestamps, timestamps + header.stepCount, timestamp) - timestamps);
+    }
+    uint32_t upperRow(long long timestamp) const {
+        return static_cast<uint32_t>(std::upper_bound(timestamps, timestamps + header.stepCount, timestamp) - timestamps);
+    }
+};
+
+bool StepSegment::map(const std::string& path, std::string& error) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        error = "Failed to open " + path + ": " + strerror(errno);
+        return false;
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || static_cast<size_t>(info.st_size) < sizeof(SegmentHeader)) {
+        close(fd);
+        error = "Truncated history segment " + path;
+        return false;
+    }
+
+    size = static_cast<size_t>(info.st_size);
+    void* mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED) {
+        error = "Failed to map " + path + ": " + strerror(errno);
+        return false;
+    }
+    base = static_cast<const uint8_t*>(mapped);
+    std::memcpy(&header, base, sizeof(header));
+
+    const uint64_t count = header.stepCount;
+    bool valid = std::memcmp(header.magic, kSegmentMagic, sizeof(kSegmentMagic)) == 0 &&
+                 header.version == kSegmentVersion &&
+                 header.fileSize == size &&
+                 header.timestampsOffset <= size &&
+                 header.recordIndexOffset <= size &&
+                 header.timestampsOffset >= sizeof(SegmentHeader) &&
+                 header.timestampsOffset % 8 == 0 &&
+                 header.recordIndexOffset % 8 == 0 &&
+                 header.recordIndexOffset >= header.timestampsOffset + count * sizeof(int64_t) &&
+                 header.fieldOffsets[0] >= header.recordIndexOffset + (count + 1) * sizeof(uint64_t) &&
+                 header.recordsOffset <= size;
+    // Sections must be in file order, so each one ends inside the file
+    for (int field = 0; valid && field < kStepFieldCount; field++) {
+        uint64_t end = field + 1 < kStepFieldCount ? header.fieldOffsets[field + 1] : header.recordsOffset;
+        valid = header.fieldOffsets[field] <= end;
+    }
+    for (int field = 0; valid && field < kStepFieldCount; field++) {
+        uint64_t begin = header.fieldOffsets[field];
+        uint64_t end = field + 1 < kStepFieldCount ? header.fieldOffsets[field + 1] : header.recordsOffset;
+        valid = begin % 8 == 0 && end - begin >= 8;
+        if (!valid) {
+            break;
+        }
+
+        FieldIndex& index = fields[field];
+        index.section = base + begin;
+        index.sectionSize = end - begin;
+        std::memcpy(&index.termCount, index.section, sizeof(uint32_t));
+        index.terms = reinterpret_cast<const TermEntry*>(index.section + 8);
+        valid = index.termCount <= (index.sectionSize - 8) / sizeof(TermEntry);
+
+        for (uint32_t i = 0; valid && i < index.termCount; i++) {
+            const TermEntry& term = index.terms[i];
+            valid = term.postingsOffset % 4 == 0 &&
+                    static_cast<uint64_t>(term.textOffset) + term.textLength <= index.sectionSize &&
+                    static_cast<uint64_t>(term.postingsOffset) + term.postingsCount * uint64_t(4) <= index.sectionSize;
+        }
+    }
+    if (!valid) {
+        error = "Corrupt history segment " + path;
+        return false;
+    }
+
+    timestamps = reinterpret_cast<const int64_t*>(base + header.timestampsOffset);
+    recordIndex = reinterpret_cast<const uint64_t*>(base + header.recordIndexOffset);
+    records = base + header.recordsOffset;
+    recordsSize = size - header.recordsOffset;
+    return true;
+}
+
+bool StepSegment::postings(int field, const std::string& term, const uint32_t*& begin, const uint32_t*& end) const {
+    const FieldIndex& index = fields[field];
+    const char* text = reinterpret_cast<const char*>(index.section);
+
+    const TermEntry* first = index.terms;
+    const TermEntry* last = index.terms + index.termCount;
+    const TermEntry* found = std::lower_bound(first, last, term, [text](const TermEntry& entry, const std::string& value) {
+        return value.compare(0, value.size(), text + entry.textOffset, entry.textLength) > 0;
+    });
+    if (found == last || term.compare(0, term.size(), text + found->textOffset, found->textLength) != 0) {
+        return false;
+    }
+
+    begin = reinterpret_cast<const uint32_t*>(index.section + found->postingsOffset);
+    end = begin + found->postingsCount;
+    return true;
+}
+
+namespace {
+
+// Rows matching any of several posting lists
+struct RowSet {
+    std::vector<std::pair<const uint32_t*, const uint32_t*>> lists;
+
+    size_t size() const {
+        size_t total = 0;
+        for (const auto& list : lists) {
+            total += static_cast<size_t>(list.second - list.first);
+        }
+        return total;
+    }
+
+    // Smallest row >= target, or kNoRow
+    uint32_t seekUp(uint32_t target) const {
+        uint32_t best = kNoRow;
+        for (const auto& list : lists) {
+            const uint32_t* it = std::lower_bound(list.first, list.second, target);
+            // The >= / <= checks keep a corrupt, unsorted list from looping
+            if (it != list.second && *it >= target && *it < best) {
+                best = *it;
+            }
+        }
+        return best;
+    }
+
+    // Largest row <= target, or kNoRow
+    uint32_t seekDown(uint32_t target) const {
+        uint32_t best = kNoRow;
+        for (const auto& list : lists) {
+            const uint32_t* it = std::upper_bound(list.first, list.second, target);
+            if (it != list.first && it[-1] <= target && (best == kNoRow || it[-1] > best)) {
+                best = it[-1];
+            }
+        }
+        return best;
+    }
+};
+
+// Walks the rows of one segment that are in [lo, hi) and in every RowSet,
+// leapfrogging between the sets
+class SegmentMatcher {
+public:
+    SegmentMatcher(const StepSegment* segment, std::vector<RowSet> sets, uint32_t lo, uint32_t hi, bool descending)
+      : segment(segment), sets(std::move(sets)), lo(lo), hi(hi), descending(descending) {}
+
+    bool next(uint32_t& row) {
+        return descending ? nextDown(row) : nextUp(row);
+    }
+
+    const StepSegment* segment;
+
+private:
+    bool nextUp(uint32_t& row) {
+        uint32_t candidate = lo;
+        while (candidate < hi) {
+            bool agreed = true;
+            for (const RowSet& set : sets) {
+                uint32_t found = set.seekUp(candidate);
+                if (found == kNoRow || found >= hi) {
+                    lo = hi;
+                    return false;
+                }
+                if (found != candidate) {
+                    candidate = found;
+                    agreed = false;
+                    break;
+                }
+            }
+            if (agreed) {
+                row = candidate;
+                lo = candidate + 1;
+                return true;
+            }
+        }
+        lo = hi;
+        return false;
+    }
+
+    bool nextDown(uint32_t& row) {
+        while (hi > lo) {
+            uint32_t candidate = hi - 1;
+            bool agreed = true;
+            for (const RowSet& set : sets) {
+                uint32_t found = set.seekDown(candidate);
+                if (found == kNoRow || found < lo) {
+                    hi = lo;
+                    return false;
+                }
+                if (found != candidate) {
+                    hi = found + 1;
+                    agreed = false;
+                    break;
+                }
+            }
+            if (agreed) {
+                row = candidate;
+                hi = candidate;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    std::vector<RowSet> sets;
+    uint32_t lo;
+    uint32_t hi;
+    bool descending;
+};
+
+struct Match {
+    long long timestamp;
+    uint32_t segment;
+    uint32_t row;
+    size_t matcher;
+};
+
+bool matchBefore(const Match& a, const Match& b) {
+    if (a.timestamp != b.timestamp) {
+        return a.timestamp < b.timestamp;
+    }
+    if (a.segment != b.segment) {
+        return a.segment < b.segment;
+    }
+    return a.row < b.row;
+}
+
+}
+
+StepStoreWriter::StepStoreWriter(size_t segmentSteps)
+  : segmentSteps(segmentSteps == 0 ? 1 : segmentSteps),
+    nextSegment(0) {
+}
+
+StepStoreWriter::~StepStoreWriter() {
+    std::string error;
+    flush(error);
+}
+
+bool StepStoreWriter::open(const std::string& path, std::string& error) {
+    if (mkdir(path.c_str(), 0755) != 0 && errno != EEXIST) {
+        error = "Failed to create history directory " + path + ": " + strerror(errno);
+        return false;
+    }
+
+    std::vector<uint32_t> numbers;
+    if (!listSegments(path, numbers, error)) {
+        return false;
+    }
+    directory = path;
+    nextSegment = numbers.empty() ? 0 : numbers.back() + 1;
+    return true;
+}
+
+bool StepStoreWriter::append(const RecordedStep& step, std::string& error) {
+    buffered.push_back(step);
+    if (buffered.size() >= segmentSteps) {
+        return writeSegment(error);
+    }
+    return true;
+}
+
+bool StepStoreWriter::flush(std::string& error) {
+    if (buffered.empty() || directory.empty()) {
+        return true;
+    }
+    return writeSegment(error);
+}
+
+bool StepStoreWriter::writeSegment(std::string& error) {
+    std::stable_sort(buffered.begin(), buffered.end(), [](const RecordedStep& a, const RecordedStep& b) {
+        return a.timestamp < b.timestamp;
+    });
+    const uint32_t count = static_cast<uint32_t>(buffered.size());
+
+    SegmentHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, kSegmentMagic, sizeof(kSegmentMagic));
+    header.version = kSegmentVersion;
+    header.stepCount = count;
+    header.minTimestamp = buffered.front().timestamp;
+    header.maxTimestamp = buffered.back().timestamp;
+
+    std::string file(sizeof(SegmentHeader), '\0');
+    alignTo8(file);
+    header.timestampsOffset = file.size();
+    for (const RecordedStep& step : buffered) {
+        writeValue<int64_t>(file, step.timestamp);
+    }
+
+    std::string records;
+    std::string encoded;
+    alignTo8(file);
+    header.recordIndexOffset = file.size();
+    for (const RecordedStep& step : buffered) {
+        writeValue<uint64_t>(file, records.size());
+        encodeStep(step, encoded);
+        records.append(encoded);
+    }
+    writeValue<uint64_t>(file, records.size());
+
+    for (int field = 0; field < kStepFieldCount; field++) {
+        std::map<std::string, std::vector<uint32_t>> terms;
+        for (uint32_t row = 0; row < count; row++) {
+            terms[fieldValue(buffered[row], field)].push_back(row);
+        }
+
+        std::string section;
+        writeValue<uint32_t>(section, static_cast<uint32_t>(terms.size()));
+        writeValue<uint32_t>(section, 0);
+        size_t entriesAt = section.size();
+        section.resize(entriesAt + terms.size() * sizeof(TermEntry));
+
+        std::vector<TermEntry> entries;
+        for (const auto& term : terms) {
+            TermEntry entry;
+            entry.postingsOffset = static_cast<uint32_t>(section.size());
+            entry.postingsCount = static_cast<uint32_t>(term.second.size());
+            section.append(reinterpret_cast<const char*>(term.second.data()), term.second.size() * sizeof(uint32_t));
+            entries.push_back(entry);
+        }
+        size_t index = 0;
+        for (const auto& term : terms) {
+            entries[index].textOffset = static_cast<uint32_t>(section.size());
+            entries[index].textLength = static_cast<uint32_t>(term.first.size());
+            section.append(term.first);
+            index++;
+        }
+        std::memcpy(&section[entriesAt], entries.data(), entries.size() * sizeof(TermEntry));
+
+        alignTo8(file);
+        header.fieldOffsets[field] = file.size();
+        file.append(section);
+    }
+
+    alignTo8(file);
+    header.recordsOffset = file.size();
+    file.append(records);
+    header.fileSize = file.size();
+    std::memcpy(&file[0], &header, sizeof(header));
+
+    // Written under a temporary name and linked into place, so readers never
+    // see a partial segment and two writers never share a number
+    std::string temporary = directory + "/.segment-XXXXXX";
+    int fd = mkstemp(&temporary[0]);
+    if (fd < 0) {
+        error = "Failed to create history segment: " + std::string(strerror(errno));
+        return false;
+    }
+
+    size_t written = 0;
+    while (written < file.size()) {
+        ssize_t result = write(fd, file.data() + written, file.size() - written);
+        if (result < 0 && errno == EINTR) {
+            continue;
+        }
+        if (result <= 0) {
+            error = "Failed to write history segment: " + std::string(strerror(errno));
+            close(fd);
+            unlink(temporary.c_str());
+            return false;
+        }
+        written += static_cast<size_t>(result);
+    }
+    fsync(fd);
+    close(fd);
+
+    while (link(temporary.c_str(), (directory + "/" + segmentName(nextSegment)).c_str()) != 0) {
+        if (errno != EEXIST) {
+            error = "Failed to publish history segment: " + std::string(strerror(errno));
+            unlink(temporary.c_str());
+            return false;
+        }
+        nextSegment++;
+    }
+    unlink(temporary.c_str());
+
+    nextSegment++;
+    buffered.clear();
+    return true;
+}
+
+StepStore::StepStore() {
+}
+
+StepStore::~StepStore() {
+}
+
+bool StepStore::open(const std::string& path, std::string& error) {
+    directory = path;
+    segments.clear();
+    corrupt.clear();
+    return refresh(error);
+}
+
+bool StepStore::refresh(std::string& error) {
+    std::vector<uint32_t> numbers;
+    if (!listSegments(directory, numbers, error)) {
+        return false;
+    }
+
+    for (uint32_t number : numbers) {
+        bool loaded = std::any_of(segments.begin(), segments.end(), [number](const std::unique_ptr<StepSegment>& segment) {
+            return segment->number == number;
+        });
+        if (loaded || std::find(corrupt.begin(), corrupt.end(), number) != corrupt.end()) {
+            continue;
+        }
+
+        // Segments are linked into place whole, so one that does not map is
+        // damaged for good; the rest of the history stays queryable
+        std::unique_ptr<StepSegment> segment(new StepSegment());
+        segment->number = number;
+        std::string segmentError;
+        if (!segment->map(directory + "/" + segmentName(number), segmentError)) {
+            corrupt.push_back(number);
+            continue;
+        }
+        segments.push_back(std::move(segment));
+    }
+
+    std::sort(segments.begin(), segments.end(), [](const std::unique_ptr<StepSegment>& a, const std::unique_ptr<StepSegment>& b) {
+        return a->number < b->number;
+    });
+    return true;
+}
+
+bool StepStore::query(const StepQuery& query, StepPage& page, std::string& error) const {
+    page = StepPage();
+    if (query.limit == 0 || query.from > query.until) {
+        return true;
+    }
+
+    const bool descending = query.newestFirst;
+    const StepCursor& cursor = query.after;
+
+    std::vector<SegmentMatcher> matchers;
+    for (const std::unique_ptr<StepSegment>& owned : segments) {
+        const StepSegment& segment = *owned;
+
+        // Min/max skipping, including everything the cursor has passed
+        long long from = query.from;
+        long long until = query.until;
+        if (query.hasCursor) {
+            if (descending) {
+                until = std::min(until, cursor.timestamp);
+            } else {
+                from = std::max(from, cursor.timestamp);
+            }
+        }
+        if (segment.header.stepCount == 0 || segment.header.maxTimestamp < from || segment.header.minTimestamp > until) {
+            page.segmentsSkipped++;
+            continue;
+        }
+
+        uint32_t lo = segment.lowerRow(query.from);
+        uint32_t hi = segment.upperRow(query.until);
+        if (query.hasCursor) {
+            // Keep only rows ordered strictly after the cursor: (timestamp, segment, row)
+            if (descending) {
+                uint32_t end = segment.number < cursor.segment ? segment.upperRow(cursor.timestamp)
+                             : segment.number == cursor.segment ? cursor.row
+                             : segment.lowerRow(cursor.timestamp);
+                hi = std::min(hi, end);
+            } else {
+                uint32_t begin = segment.number > cursor.segment ? segment.lowerRow(cursor.timestamp)
+                               : segment.number == cursor.segment ? cursor.row + 1
+                               : segment.upperRow(cursor.timestamp);
+                lo = std::max(lo, begin);
+            }
+        }
+        if (lo >= hi) {
+            page.segmentsSkipped++;
+            continue;
+        }
+
+        std::vector<RowSet> sets;
+        bool possible = true;
+        for (int field = 0; field < kStepFieldCount && possible; field++) {
+            if (query.terms[field].empty()) {
+                continue;
+            }
+            RowSet set;
+            for (const std::string& term : query.terms[field]) {
+                const uint32_t* begin;
+                const uint32_t* end;
+                if (segment.postings(field, term, begin, end)) {
+                    set.lists.emplace_back(begin, end);
+                }
+            }
+            possible = !set.lists.empty();
+            sets.push_back(std::move(set));
+        }
+        if (!possible) {
+            page.segmentsSkipped++;
+            continue;
+        }
+        // The sparsest set drives the leapfrog; denser ones are only probed
+        std::sort(sets.begin(), sets.end(), [](const RowSet& a, const RowSet& b) {
+            return a.size() < b.size();
+        });
+
+        page.segmentsSearched++;
+        matchers.emplace_back(&segment, std::move(sets), lo, hi, descending);
+    }
+
+    auto after = [descending](const Match& a, const Match& b) {
+        return descending ? matchBefore(a, b) : matchBefore(b, a);
+    };
+    std::priority_queue<Match, std::vector<Match>, decltype(after)> heap(after);
+
+    for (size_t i = 0; i < matchers.size(); i++) {
+        uint32_t row;
+        if (matchers[i].next(row)) {
+            heap.push({matchers[i].segment->timestamps[row], matchers[i].segment->number, row, i});
+        }
+    }
+
+    while (!heap.empty()) {
+        if (page.steps.size() == query.limit) {
+            page.hasMore = true;
+            break;
+        }
+
+        Match match = heap.top();
+        heap.pop();
+
+        const StepSegment& segment = *matchers[match.matcher].segment;
+        uint64_t begin = segment.recordIndex[match.row];
+        uint64_t end = segment.recordIndex[match.row + 1];
+        RecordedStep step;
+        if (begin > end || end > segment.recordsSize ||
+            !decodeStep(segment.records + begin, static_cast<size_t>(end - begin), step)) {
+            error = "Corrupt record in history segment " + segmentName(segment.number);
+            return false;
+        }
+        page.steps.push_back(std::move(step));
+        page.next.timestamp = match.timestamp;
+        page.next.segment = match.segment;
+        page.next.row = match.row;
+
+        uint32_t row;
+        if (matchers[match.matcher].next(row)) {
+            heap.push({segment.timestamps[row], segment.number, row, match.matcher});
+        }
+    }
+
+    return true;
+}
+
+StepStoreStats StepStore::stats() const {
+    StepStoreStats result;
+    for (const std::unique_ptr<StepSegment>& segment : segments) {
+        if (segment->header.stepCount == 0) {
+            continue;
+        }
+        if (result.steps == 0 || segment->header.minTimestamp < result.minTimestamp) {
+            result.minTimestamp = segment->header.minTimestamp;
+        }
+        if (result.steps == 0 || segment->header.maxTimestamp > result.maxTimestamp) {
+            result.maxTimestamp = segment->header.maxTimestamp;
+        }
+        result.steps += segment->header.stepCount;
+    }
+    result.segments = segments.size();
+    result.corruptSegments = corrupt.size();
+    for (const std::unique_ptr<StepSegment>& segment : segments) {
+        result.mappedBytes += segment->size;
+    }
+    return result;
+}
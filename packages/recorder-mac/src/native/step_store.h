@@ -0,0 +1,104 @@
+#pragma once
+
+// On-disk history of RecordedStep. Steps are written in immutable segment
+// files, sorted by timestamp, each with a min/max timestamp in its header and
+// an inverted index (term -> sorted row ids) per indexed field. Readers mmap
+// the segments, skip those outside the time range, intersect posting lists
+// inside the rest, and merge matches across segments in timestamp order.
+// Only POSIX file APIs are used.
+
+#include "recorder_types.h"
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+enum StepField {
+    kStepFieldApp = 0,       // appInfo.name
+    kStepFieldAction,
+    kStepFieldRole,          // targetDescriptor.role
+    kStepFieldIdentifier,    // targetDescriptor.identifier
+    kStepFieldSession,
+    kStepFieldCount
+};
+
+// Position of a returned step; queries resume strictly after it
+struct StepCursor {
+    long long timestamp = 0;
+    uint32_t segment = 0;
+    uint32_t row = 0;
+};
+
+struct StepQuery {
+    long long from = LLONG_MIN; // Inclusive, milliseconds
+    long long until = LLONG_MAX;
+    // Any term of a field may match; every non-empty field must match
+    std::vector<std::string> terms[kStepFieldCount];
+    bool newestFirst = false;
+    size_t limit = 100;
+    bool hasCursor = false;
+    StepCursor after;
+};
+
+struct StepPage {
+    std::vector<RecordedStep> steps;
+    bool hasMore = false;
+    StepCursor next;
+    size_t segmentsSearched = 0;
+    size_t segmentsSkipped = 0;
+};
+
+struct StepStoreStats {
+    size_t segments = 0;
+    size_t corruptSegments = 0; // Present on disk but failed to map; not queried
+    uint64_t steps = 0;
+    uint64_t mappedBytes = 0;
+    long long minTimestamp = 0;
+    long long maxTimestamp = 0;
+};
+
+// Buffers appended steps and writes them out as a segment once
+// `segmentSteps` are pending, or on flush()
+class StepStoreWriter {
+public:
+    explicit StepStoreWriter(size_t segmentSteps = 65536);
+    ~StepStoreWriter();
+
+    bool open(const std::string& directory, std::string& error);
+    bool append(const RecordedStep& step, std::string& error);
+    bool flush(std::string& error);
+
+    size_t pending() const { return buffered.size(); }
+
+private:
+    bool writeSegment(std::string& error);
+
+    std::string directory;
+    size_t segmentSteps;
+    uint32_t nextSegment;
+    std::vector<RecordedStep> buffered;
+};
+
+// One mapped segment file; defined in step_store.cpp
+struct StepSegment;
+
+class StepStore {
+public:
+    StepStore();
+    ~StepStore();
+
+    bool open(const std::string& directory, std::string& error);
+    // Maps segments written since open() or the last refresh(). A segment
+    // that fails to map is skipped and counted, not retried; only a directory
+    // that cannot be listed fails.
+    bool refresh(std::string& error);
+    bool query(const StepQuery& query, StepPage& page, std::string& error) const;
+    StepStoreStats stats() const;
+
+private:
+    std::string directory;
+    std::vector<std::unique_ptr<StepSegment>> segments; // Ordered by segment number
+    std::vector<uint32_t> corrupt; // Segment numbers that failed to map
+};
@@ -0,0 +1,101 @@
+#include "window_observer.h"
+#include "ax_element.h"
+
+WindowObserver::WindowObserver(ChangeCallback callback) :
+    callback(callback),
+    runLoop(nullptr) {}
+
+WindowObserver::~WindowObserver() {
+    detach();
+}
+
+void WindowObserver::attach(CFRunLoopRef runLoop) {
+    std::lock_guard<std::mutex> lock(mutex);
+    this->runLoop = runLoop;
+}
+
+void WindowObserver::detach() {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (auto& entry : observers) {
+        if (runLoop) {
+            CFRunLoopRemoveSource(runLoop, AXObserverGetRunLoopSource(entry.second), kCFRunLoopDefaultMode);
+        }
+        CFRelease(entry.second);
+    }
+    observers.clear();
+    runLoop = nullptr;
+}
+
+void WindowObserver::observe(pid_t pid, AXUIElementRef window) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!runLoop) {
+        return;
+    }
+    
+    auto it = observers.find(pid);
+    if (it == observers.end()) {
+        AXObserverRef observer = nullptr;
+        if (AXObserverCreate(pid, onNotification, &observer) != kAXErrorSuccess || !observer) {
+            return;
+        }
+        
+        // Move/resize/focus are reported once per app for all of its windows
+        AXUIElementRef app = AXUIElementCreateApplication(pid);
+        AXObserverAddNotification(observer, app, CFSTR(kAXWindowMovedNotification), this);
+        AXObserverAddNotification(observer, app, CFSTR(kAXWindowResizedNotification), this);
+        AXObserverAddNotification(observer, app, CFSTR(kAXFocusedWindowChangedNotification), this);
+        // Tab and popover changes move or replace elements inside a window;
+        // value changes are reported for the one element whose value changed
+        AXObserverAddNotification(observer, app, CFSTR(kAXLayoutChangedNotification), this);
+        AXObserverAddNotification(observer, app, CFSTR(kAXValueChangedNotification), this);
+        CFRelease(app);
+        
+        CFRunLoopAddSource(runLoop, AXObserverGetRunLoopSource(observer), kCFRunLoopDefaultMode);
+        it = observers.emplace(pid, observer).first;
+    }
+    
+    // Destruction has to be registered per window; re-registering is a no-op
+    AXObserverAddNotification(it->second, window, CFSTR(kAXUIElementDestroyedNotification), this);
+}
+
+uint64_t WindowObserver::windowId(AXUIElementRef window) {
+    // AX hands out fresh refs for the same window; CFHash is stable across them
+    return static_cast<uint64_t>(CFHash(window));
+}
+
+void WindowObserver::onNotification(AXObserverRef observer, AXUIElementRef element, CFStringRef notification, void* refcon) {
+    WindowObserver* self = static_cast<WindowObserver*>(refcon);
+    pid_t pid = 0;
+    AXUIElementGetPid(element, &pid);
+    Frame frame = {0, 0, 0, 0};
+    
+    uint64_t id = windowId(element);
+    if (CFEqual(notification, CFSTR(kAXValueChangedNotification))) {
+        self->callback(pid, id, WindowChange::Value, frame, element);
+        return;
+    }
+    if (CFEqual(notification, CFSTR(kAXLayoutChangedNotification))) {
+        self->callback(pid, id, WindowChange::Layout, frame, element);
+        return;
+    }
+    if (CFEqual(notification, CFSTR(kAXUIElementDestroyedNotification))) {
+        self->callback(pid, id, WindowChange::Destroyed, frame, element);
+        return;
+    }
+    
+    AXElementInfo windowInfo;
+    windowInfo.setElement(element);
+    CGRect rect = windowInfo.getFrame();
+    frame = {
+        static_cast<int>(rect.origin.x),
+        static_cast<int>(rect.origin.y),
+        static_cast<int>(rect.size.width),
+        static_cast<int>(rect.size.height)
+    };
+    
+    if (CFEqual(notification, CFSTR(kAXFocusedWindowChangedNotification))) {
+        self->callback(pid, id, WindowChange::Raised, frame, element);
+    } else {
+        self->callback(pid, id, WindowChange::Frame, frame, element);
+    }
+}
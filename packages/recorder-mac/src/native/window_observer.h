@@ -0,0 +1,35 @@
+#pragma once
+
+#include "event_monitor.h"
+#include <ApplicationServices/ApplicationServices.h>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <unordered_map>
+
+// Watches window move/resize/focus/close and layout/value change
+// notifications for the apps whose elements are in the frame index.
+// Notifications arrive on the tap thread's run loop; observe() is called from
+// the index thread.
+class WindowObserver {
+public:
+    using ChangeCallback = std::function<void(pid_t pid, uint64_t windowId, WindowChange change,
+                                              const Frame& frame, AXUIElementRef element)>;
+
+    explicit WindowObserver(ChangeCallback callback);
+    ~WindowObserver();
+
+    void attach(CFRunLoopRef runLoop);
+    void detach();
+    void observe(pid_t pid, AXUIElementRef window);
+
+    static uint64_t windowId(AXUIElementRef window);
+
+private:
+    static void onNotification(AXObserverRef observer, AXUIElementRef element, CFStringRef notification, void* refcon);
+
+    ChangeCallback callback;
+    std::mutex mutex;
+    CFRunLoopRef runLoop;
+    std::unordered_map<pid_t, AXObserverRef> observers;
+};
@@ -0,0 +1,133 @@
+#include "work_stealing_pool.h"
+
+namespace {
+
+// Set on pool threads so submit() can push onto the caller's own deque
+thread_local const WorkStealingPool* currentPool = nullptr;
+thread_local size_t currentWorker = 0;
+
+}
+
+WorkStealingPool::WorkStealingPool(size_t threadCount)
+  : queued(0),
+    outstanding(0),
+    nextVictim(0),
+    stopping(false),
+    executed(0),
+    steals(0),
+    localPushes(0) {
+    if (threadCount == 0) {
+        threadCount = std::thread::hardware_concurrency();
+    }
+    if (threadCount == 0) {
+        threadCount = 1;
+    }
+
+    for (size_t i = 0; i < threadCount; i++) {
+        workers.emplace_back(new Worker());
+    }
+    for (size_t i = 0; i < threadCount; i++) {
+        threads.emplace_back(&WorkStealingPool::run, this, i);
+    }
+}
+
+WorkStealingPool::~WorkStealingPool() {
+    waitIdle();
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        stopping = true;
+    }
+    workAvailable.notify_all();
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+}
+
+void WorkStealingPool::submit(Task task) {
+    size_t index;
+    if (currentPool == this) {
+        index = currentWorker;
+        localPushes++;
+    } else {
+        index = nextVictim.fetch_add(1, std::memory_order_relaxed) % workers.size();
+    }
+
+    // Counted before the push so `queued` never underflows, and under the
+    // sleep lock so a worker about to sleep sees it
+    outstanding++;
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        queued++;
+    }
+    {
+        std::lock_guard<std::mutex> lock(workers[index]->mutex);
+        workers[index]->tasks.push_back(std::move(task));
+    }
+    workAvailable.notify_one();
+}
+
+bool WorkStealingPool::popLocal(size_t index, Task& task) {
+    Worker& worker = *workers[index];
+    std::lock_guard<std::mutex> lock(worker.mutex);
+    if (worker.tasks.empty()) {
+        return false;
+    }
+    task = std::move(worker.tasks.back());
+    worker.tasks.pop_back();
+    return true;
+}
+
+bool WorkStealingPool::steal(size_t thief, Task& task) {
+    for (size_t offset = 1; offset < workers.size(); offset++) {
+        Worker& victim = *workers[(thief + offset) % workers.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.tasks.empty()) {
+            // Oldest first: it is the least likely to be hot in the victim's cache
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            steals++;
+            return true;
+        }
+    }
+    return false;
+}
+
+void WorkStealingPool::run(size_t index) {
+    currentPool = this;
+    currentWorker = index;
+
+    while (true) {
+        Task task;
+        if (popLocal(index, task) || steal(index, task)) {
+            queued--;
+            task();
+            executed++;
+
+            if (--outstanding == 0) {
+                std::lock_guard<std::mutex> lock(sleepMutex);
+                idle.notify_all();
+            }
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        workAvailable.wait(lock, [this] { return stopping || queued > 0; });
+        if (stopping && queued == 0) {
+            return;
+        }
+    }
+}
+
+void WorkStealingPool::waitIdle() {
+    std::unique_lock<std::mutex> lock(sleepMutex);
+    idle.wait(lock, [this] { return outstanding == 0; });
+}
+
+WorkPoolStats WorkStealingPool::getStats() const {
+    WorkPoolStats stats;
+    stats.executed = executed;
+    stats.steals = steals;
+    stats.localPushes = localPushes;
+    stats.threads = workers.size();
+    return stats;
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+// Fixed pool for non-UI flow work (selector resolution, snapshot diffing,
+// data binding, screenshot encoding). Each worker owns a deque: it pushes
+// and pops its own tasks at the back, and idle workers steal from the
+// front of the others, so follow-up work stays on a warm core.
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+struct WorkPoolStats {
+    uint64_t executed = 0;
+    uint64_t steals = 0;
+    uint64_t localPushes = 0; // Submitted from a worker onto its own deque
+    size_t threads = 0;
+};
+
+class WorkStealingPool {
+public:
+    using Task = std::function<void()>;
+
+    // threads 0 = one per hardware thread
+    explicit WorkStealingPool(size_t threads = 0);
+    ~WorkStealingPool();
+
+    void submit(Task task);
+    // Blocks until every submitted task, including ones they submit, has run
+    void waitIdle();
+
+    size_t size() const { return workers.size(); }
+    WorkPoolStats getStats() const;
+
+private:
+    struct Worker {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    void run(size_t index);
+    bool popLocal(size_t index, Task& task);
+    bool steal(size_t thief, Task& task);
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::vector<std::thread> threads;
+
+    std::mutex sleepMutex;
+    std::condition_variable workAvailable;
+    std::condition_variable idle;
+    std::atomic<size_t> queued;      // In a deque, not yet picked up
+    std::atomic<size_t> outstanding; // Queued or running
+    std::atomic<size_t> nextVictim;
+    bool stopping;
+
+    std::atomic<uint64_t> executed;
+    std::atomic<uint64_t> steals;
+    std::atomic<uint64_t> localPushes;
+};
@@ -1,7 +1,13 @@
 import { EventEmitter } from 'events';
 import { createRequire } from 'module';
+import { fileURLToPath } from 'url';
 import {
   RecordedStep,
+  RecorderFilter,
+  RecorderOptions,
+  TapStats,
+  PrefetchStats,
+  IndexStats,
   RecorderEvents,
   RecorderEventType,
   Flow,
@@ -14,8 +20,12 @@ interface NativeAXRecorder {
   startRecording(sessionId: string): boolean;
   stopRecording(): boolean;
   isRecording(): boolean;
+  isPending(): boolean;
   getRecordedSteps(): RecordedStep[];
   clearSteps(): boolean;
+  getTapStats(): TapStats;
+  getPrefetchStats(): PrefetchStats;
+  getIndexStats(): IndexStats;
 }
 
 export class MacRecorder extends EventEmitter {
@@ -24,14 +34,28 @@ export class MacRecorder extends EventEmitter {
   private stepPollingInterval: NodeJS.Timeout | null = null;
   private lastStepCount = 0;
 
-  constructor() {
+  /**
+   * @param filter Optional native-side filter; events it rejects are never
+   * resolved or delivered to this recorder
+   * @param options Set `outOfProcess` to capture in the helper executable;
+   * `helperPath` defaults to the one built next to the addon
+   */
+  constructor(filter?: RecorderFilter, options?: RecorderOptions) {
     super();
 
     try {
       // Load the native addon using createRequire for ES modules
       const require = createRequire(import.meta.url);
       const addon = require('../build/Release/ax_recorder.node');
-      this.nativeRecorder = new addon.AXRecorder();
+      const helperPath =
+        options?.helperPath ??
+        fileURLToPath(
+          new URL('../build/Release/ax_recorder_helper', import.meta.url)
+        );
+      this.nativeRecorder = new addon.AXRecorder(filter, {
+        outOfProcess: options?.outOfProcess ?? false,
+        helperPath,
+      });
     } catch (error) {
       throw new Error(
         `Failed to load native AX recorder addon. Make sure it's built and accessibility permissions are granted. Error: ${error}`
@@ -49,7 +73,12 @@ export class MacRecorder extends EventEmitter {
       throw new Error('Recording is already in progress');
     }
 
-    const success = this.nativeRecorder.startRecording(sessionId);
+    let success = this.nativeRecorder.startRecording(sessionId);
+    if (success) {
+      // Out of process, the helper confirms the start asynchronously
+      await this.settle();
+      success = this.nativeRecorder.isRecording();
+    }
     if (!success) {
       throw new Error(
         'Failed to start recording. Make sure accessibility permissions are granted.'
@@ -72,6 +101,7 @@ export class MacRecorder extends EventEmitter {
 
     this.stopStepPolling();
     this.nativeRecorder.stopRecording();
+    await this.settle();
 
     // Get ALL recorded steps (not just new ones since polling already consumed them)
     const finalSteps = this.nativeRecorder.getRecordedSteps();
@@ -93,6 +123,27 @@ export class MacRecorder extends EventEmitter {
     return this.nativeRecorder.isRecording();
   }
 
+  /**
+   * Get event tap recovery counters
+   */
+  public getTapStats(): TapStats {
+    return this.nativeRecorder.getTapStats();
+  }
+
+  /**
+   * Get hover-dwell prefetch hit rate and click-path latency counters
+   */
+  public getPrefetchStats(): PrefetchStats {
+    return this.nativeRecorder.getPrefetchStats();
+  }
+
+  /**
+   * Get local element frame index counters
+   */
+  public getIndexStats(): IndexStats {
+    return this.nativeRecorder.getIndexStats();
+  }
+
   /**
    * Get the current session ID
    */
@@ -223,6 +274,16 @@ export class MacRecorder extends EventEmitter {
     }
   }
 
+  /**
+   * Wait until no helper command is in flight. The native side gives up on a
+   * reply after five seconds, so this always resolves.
+   */
+  private async settle(): Promise<void> {
+    while (this.nativeRecorder.isPending()) {
+      await new Promise((resolve) => setTimeout(resolve, 5));
+    }
+  }
+
   /**
    * Collect new steps since last check
    */
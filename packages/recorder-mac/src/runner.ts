@@ -0,0 +1,171 @@
+import { createRequire } from 'module';
+import {
+  Flow,
+  FlowRunTiming,
+  FlowStep,
+  RunnerOptions,
+  RunnerStats,
+} from './types.js';
+
+type StepExecutor = (step: FlowStep, index: number) => Promise<boolean>;
+
+// Native addon interface
+interface NativeFlowRunner {
+  submit(flow: {
+    name: string;
+    steps: { kind: 'input' | 'work'; app: string }[];
+  }): number;
+  takeSteps(maxSteps: number): {
+    callId: number;
+    flowId: number;
+    stepIndex: number;
+  }[];
+  completeStep(callId: number, ok: boolean): boolean;
+  cancel(flowId: number): boolean;
+  cancelAll(): boolean;
+  takeFinished(): FlowRunTiming[];
+  getStats(): RunnerStats;
+  close(): boolean;
+}
+
+interface ActiveFlow {
+  flow: Flow;
+  execute: StepExecutor;
+  resolve: (timing: FlowRunTiming) => void;
+  reject: (error: Error) => void;
+}
+
+// Steps that drive an app's UI; everything else is data work
+const INPUT_STEP_TYPES: ReadonlySet<FlowStep['type']> = new Set([
+  'click',
+  'type',
+  'navigate',
+  'wait_for',
+  'open_app',
+]);
+
+/**
+ * Runs independent flows concurrently. The native scheduler gives each app an
+ * exclusive lane, so UI input for one app stays serialized across flows, and
+ * starts non-UI steps on a work-stealing pool. Steps themselves are executed
+ * by the caller's `execute` function; the scheduler moves a flow on when the
+ * returned promise settles.
+ */
+export class FlowRunner {
+  private nativeRunner: NativeFlowRunner;
+  private active = new Map<number, ActiveFlow>();
+  private pollTimer: NodeJS.Timeout | null = null;
+  private readonly pollMs: number;
+
+  constructor(options: RunnerOptions = {}) {
+    this.pollMs = options.pollMs ?? 5;
+
+    try {
+      // Load the native addon using createRequire for ES modules
+      const require = createRequire(import.meta.url);
+      const addon = require('../build/Release/ax_recorder.node');
+      this.nativeRunner = new addon.FlowRunner(options);
+    } catch (error) {
+      throw new Error(`Failed to create flow runner: ${error}`);
+    }
+  }
+
+  /**
+   * Queue a flow and resolve with its timing once it has finished, failed,
+   * timed out or been cancelled. Rejects if the runner is closed first. Input
+   * steps target `step.app`, or the app of the last `open_app` step before
+   * them.
+   */
+  public run(flow: Flow, execute: StepExecutor): Promise<FlowRunTiming> {
+    let app = '';
+    const steps = flow.steps.map((step) => {
+      if (step.type === 'open_app' && step.app) {
+        app = step.app;
+      }
+      const kind: 'input' | 'work' = INPUT_STEP_TYPES.has(step.type)
+        ? 'input'
+        : 'work';
+      return { kind, app: step.app ?? app };
+    });
+
+    return new Promise((resolve, reject) => {
+      const flowId = this.nativeRunner.submit({ name: flow.name, steps });
+      this.active.set(flowId, { flow, execute, resolve, reject });
+      this.startPolling();
+    });
+  }
+
+  /**
+   * Skip the remaining steps of a flow; a step already running finishes first
+   */
+  public cancel(flowId: number): void {
+    this.nativeRunner.cancel(flowId);
+  }
+
+  /**
+   * Cancel every queued and running flow
+   */
+  public cancelAll(): void {
+    this.nativeRunner.cancelAll();
+  }
+
+  /**
+   * Get flow, step and work pool counters
+   */
+  public getStats(): RunnerStats {
+    return this.nativeRunner.getStats();
+  }
+
+  /**
+   * Stop the scheduler. Flows that had already finished resolve as usual;
+   * every other `run()` promise rejects. Results of steps still executing
+   * are ignored.
+   */
+  public close(): void {
+    this.nativeRunner.close();
+    this.poll();
+    for (const entry of this.active.values()) {
+      entry.reject(new Error(`Flow runner closed before "${entry.flow.name}" finished`));
+    }
+    this.active.clear();
+    this.stopPolling();
+  }
+
+  private startPolling(): void {
+    if (this.pollTimer) {
+      return;
+    }
+    this.pollTimer = setInterval(() => this.poll(), this.pollMs);
+  }
+
+  private stopPolling(): void {
+    if (this.pollTimer) {
+      clearInterval(this.pollTimer);
+      this.pollTimer = null;
+    }
+  }
+
+  private poll(): void {
+    for (const call of this.nativeRunner.takeSteps(64)) {
+      const entry = this.active.get(call.flowId);
+      if (!entry) {
+        this.nativeRunner.completeStep(call.callId, false);
+        continue;
+      }
+      entry
+        .execute(entry.flow.steps[call.stepIndex], call.stepIndex)
+        .catch(() => false)
+        .then((ok) => this.nativeRunner.completeStep(call.callId, ok));
+    }
+
+    for (const timing of this.nativeRunner.takeFinished()) {
+      const entry = this.active.get(timing.flowId);
+      this.active.delete(timing.flowId);
+      entry?.resolve(timing);
+    }
+
+    if (this.active.size === 0) {
+      this.stopPolling();
+    }
+  }
+}
@@ -43,6 +43,72 @@ export interface RecordedStep {
   appInfo: ApplicationInfo;
 }
 
+/**
+ * Native-side filter applied before any AX lookups. Omitted or empty fields
+ * match everything; `region` is tested against the pointer location of the event.
+ */
+export interface RecorderFilter {
+  actions?: RecordedStep['action'][];
+  appName?: string;
+  processId?: number;
+  roles?: string[];
+  region?: Frame;
+}
+
+/**
+ * How the recorder hosts its event taps. With `outOfProcess` the taps and AX
+ * queries run in the `ax_recorder_helper` executable and steps arrive over
+ * shared memory, so stalls or crashes in the host process do not affect capture.
+ */
+export interface RecorderOptions {
+  outOfProcess?: boolean;
+  helperPath?: string;
+}
+
+/**
+ * Event tap health. The window server disables a tap that stalls or when
+ * secure input is toggled; the recorder re-enables it and counts each case.
+ */
+export interface TapStats {
+  timeoutRecoveries: number;
+  userInputRecoveries: number;
+  lastRecoveryAt: number;
+}
+
+/**
+ * Hover-dwell prefetch counters. Latencies are cumulative microseconds spent
+ * on the click path; `savedMicros` is the AX describe time that hits skipped.
+ * A hit requires the cached element to still be the one under the click;
+ * `staleHits` counts misses where a cached frame held a different element.
+ */
+export interface PrefetchStats {
+  prefetches: number;
+  hits: number;
+  misses: number;
+  staleHits: number;
+  hitLatencyMicros: number;
+  missLatencyMicros: number;
+  savedMicros: number;
+}
+
+/**
+ * Local frame index counters. A hit answered a click from the indexed leaf
+ * element under the point without an AX call; stale misses found only expired
+ * frames. Evictions count entries dropped because their value changed or
+ * because a hit turned out not to be the element at the point.
+ */
+export interface IndexStats {
+  hits: number;
+  misses: number;
+  staleMisses: number;
+  inserts: number;
+  windowMoves: number;
+  windowResets: number;
+  evictions: number;
+  elements: number;
+  windows: number;
+}
+
 export interface FlowStep {
   type: 'click' | 'type' | 'navigate' | 'wait_for' | 'open_app' | 'guard';
   selector?: string;
@@ -68,6 +134,156 @@ export interface Flow {
   steps: FlowStep[];
 }
 
+/**
+ * Options for running a flow over a CSV/TSV table. Placeholders such as
+ * `{{row.email}}` (or `{{<tableVariable>.email}}`) read a column from each
+ * row; `{{name}}` reads from `variables`.
+ */
+export interface BatchOptions {
+  path: string;
+  tableVariable?: string;
+  delimiter?: string;
+  variables?: Record<string, string | number | boolean>;
+  resumeFrom?: BatchCheckpoint;
+  /**
+   * Bound rows kept ready (default 256). Parsing pauses while more than four
+   * times this many rows are out past the oldest uncompleted row.
+   */
+  queueCapacity?: number;
+}
+
+/**
+ * Every row before `row` has completed. Pass it back as `resumeFrom` to
+ * continue a run; `byteOffset` lets the reader seek instead of re-parsing.
+ */
+export interface BatchCheckpoint {
+  row: number;
+  byteOffset: number;
+}
+
+export interface BatchProgress {
+  rowsParsed: number;
+  rowsQueued: number;
+  rowsCompleted: number;
+  rowsFailed: number;
+  bytesRead: number;
+  totalBytes: number;
+  bindMicros: number;
+  runMicros: number;
+  parseDone: boolean;
+  readFailed: boolean;
+}
+
+export interface RowTiming {
+  row: number;
+  bindMicros: number;
+  queueMicros: number;
+  runMicros: number;
+  ok: boolean;
+}
+
+export interface BoundFlowRow {
+  row: number;
+  byteOffset: number;
+  steps: FlowStep[];
+}
+
+/**
+ * FlowRunner settings. `workThreads` sizes the native pool for non-UI work
+ * (0 = one per core). Every FlowRunner step is run by `execute()` in JS, so
+ * the pool is never started and the work counters in RunnerStats stay 0. A
+ * step not completed within `stepTimeoutMs` fails its flow at once, but the
+ * flow's app lanes stay held until that step's `execute()` settles.
+ */
+export interface RunnerOptions {
+  workThreads?: number;
+  stepTimeoutMs?: number;
+  pollMs?: number;
+}
+
+/**
+ * Timing for one flow run by FlowRunner. `queuedMicros` is the wait for the
+ * flow's app lanes; input and work micros are time spent inside steps.
+ */
+export interface FlowRunTiming {
+  flowId: number;
+  name: string;
+  ok: boolean;
+  cancelled: boolean;
+  timedOut: boolean;
+  stepsRun: number;
+  queuedMicros: number;
+  runMicros: number;
+  inputMicros: number;
+  workMicros: number;
+}
+
+export interface RunnerStats {
+  flowsSubmitted: number;
+  flowsFinished: number;
+  flowsFailed: number;
+  inputSteps: number;
+  workSteps: number;
+  lanes: number;
+  runningFlows: number;
+  waitingFlows: number;
+  /** Timed out, still holding lanes until their running step settles */
+  abandonedFlows: number;
+  workThreads: number;
+  workExecuted: number;
+  workSteals: number;
+}
+
+export interface HistoryOptions {
+  segmentSteps?: number;
+}
+
+/**
+ * Position of the last step of a history page. Pass it back as `after` to
+ * continue from there.
+ */
+export interface HistoryCursor {
+  timestamp: number;
+  segment: number;
+  row: number;
+}
+
+/**
+ * Filter for StepHistory.query(). `from`/`until` are inclusive millisecond
+ * timestamps. Any value of a list may match, and every list given must match.
+ */
+export interface HistoryQuery {
+  from?: number;
+  until?: number;
+  apps?: string[];
+  actions?: RecordedStep['action'][];
+  roles?: string[];
+  identifiers?: string[];
+  sessionIds?: string[];
+  newestFirst?: boolean;
+  limit?: number;
+  after?: HistoryCursor;
+}
+
+export interface HistoryPage {
+  steps: RecordedStep[];
+  hasMore: boolean;
+  next: HistoryCursor | null;
+  segmentsSearched: number;
+  segmentsSkipped: number;
+}
+
+export interface HistoryStats {
+  segments: number;
+  /** Segment files that failed validation; skipped by queries */
+  corruptSegments: number;
+  steps: number;
+  pendingSteps: number;
+  mappedBytes: number;
+  minTimestamp: number;
+  maxTimestamp: number;
+}
+
 export interface RecorderEvents {
   stepRecorded: (step: RecordedStep) => void;
   recordingStarted: (sessionId: string) => void;